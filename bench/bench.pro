@@ -0,0 +1,68 @@
+#-------------------------------------------------
+#
+# Benchmarks of the simulation and rendering hot paths.
+# Built by "make bench" from the main project.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = stocktrader-bench
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    benchmark.cpp \
+    cases.cpp \
+    ../lib/qcustomplot.cpp \
+    ../src/stockpricehistoryplot.cpp \
+    ../src/localpricegen.cpp \
+    ../src/genericpricegenerator.cpp \
+    ../src/company.cpp \
+    ../src/lotqueue.cpp \
+    ../src/corporateactions.cpp \
+    ../src/basketbook.cpp \
+    ../src/ledger.cpp \
+    ../src/orderbook.cpp \
+    ../src/triggerbook.cpp \
+    ../src/marginbook.cpp \
+    ../src/portfolio.cpp \
+    ../src/indicatorbank.cpp \
+    ../src/riskbank.cpp \
+    ../src/market.cpp \
+    ../src/trace.cpp \
+    ../src/metrics.cpp \
+    ../src/allocationcounter.cpp
+
+HEADERS += benchmark.h \
+    ../lib/qcustomplot.h \
+    ../header/stockpricehistoryplot.h \
+    ../header/localpricegen.h \
+    ../header/genericpricegenerator.h \
+    ../header/company.h \
+    ../header/lotqueue.h \
+    ../header/corporateactions.h \
+    ../header/basketbook.h \
+    ../header/ledger.h \
+    ../header/money.h \
+    ../header/orderbook.h \
+    ../header/triggerbook.h \
+    ../header/marginbook.h \
+    ../header/portfolio.h \
+    ../header/indicatorbank.h \
+    ../header/riskbank.h \
+    ../header/market.h \
+    ../header/trace.h \
+    ../header/metrics.h \
+    ../header/allocationcounter.h
+
+INCLUDEPATH += . ../header/ ../lib/
+
+# The allocation counter is always on, the steady-state cases fail if they allocate
+DEFINES += STOCKTRADER_ALLOC_COUNT
+
+CONFIG(trace): DEFINES += STOCKTRADER_TRACE
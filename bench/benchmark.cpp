@@ -0,0 +1,150 @@
+#include <benchmark.h>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+
+BenchCase::BenchCase(const QString &n) :
+    name(n), allocation_free(0)
+{
+}
+
+BenchCase::~BenchCase()
+{
+}
+
+void BenchCase::setUp(void)
+{
+    return;
+}
+
+void BenchCase::tearDown(void)
+{
+    return;
+}
+
+QString BenchCase::getName(void) const
+{
+    return name;
+}
+
+bool BenchCase::isAllocationFree(AllocationPhase phase) const
+{
+    return allocation_free & (1u << phase);
+}
+
+void BenchCase::requireNoAllocations(AllocationPhase phase)
+{
+    allocation_free |= 1u << phase;
+
+    return;
+}
+
+BenchRunner::BenchRunner(int min_time, int reps) :
+    min_time_ms(min_time), repetitions(reps)
+{
+}
+
+BenchResult BenchRunner::run(BenchCase *bench)
+{
+    // Same random prices on every run
+    qsrand(bench_seed);
+
+    bench->setUp();
+
+    QElapsedTimer timer;
+    qint64 batch_time = qint64(min_time_ms) * 1000000 / repetitions;
+    qint64 batch = 1;
+
+    // Warm up and calibrate the batch size
+    for (;;)
+    {
+        timer.start();
+        for (qint64 k = 0; k < batch; k++)
+            bench->run();
+
+        if ( timer.nsecsElapsed() >= batch_time || batch >= (Q_INT64_C(1) << 30) )
+            break;
+        batch *= 2;
+    }
+
+    QVector<double> samples;
+    samples.reserve(repetitions);
+
+    quint64 allocations[allocation_phase_count];
+    for (int p = 0; p < allocation_phase_count; p++)
+        allocations[p] = AllocationCounter::count(AllocationPhase(p));
+
+    for (int r = 0; r < repetitions; r++)
+    {
+        timer.start();
+        for (qint64 k = 0; k < batch; k++)
+            bench->run();
+        samples.append(double(timer.nsecsElapsed()) / batch);
+    }
+
+    for (int p = 0; p < allocation_phase_count; p++)
+        allocations[p] = AllocationCounter::count(AllocationPhase(p)) - allocations[p];
+
+    bench->tearDown();
+
+    std::sort(samples.begin(),samples.end());
+
+    BenchResult result;
+    result.name = bench->getName();
+    result.iterations = batch * repetitions;
+    result.ns_per_op = samples[samples.size() / 2];
+    result.min_ns_per_op = samples.first();
+    result.allocs_per_op = 0;
+
+    for (int p = 0; p < allocation_phase_count; p++)
+    {
+        AllocationPhase phase = AllocationPhase(p);
+
+        result.phase_allocs_per_op[p] = double(allocations[p]) / result.iterations;
+        result.allocs_per_op += result.phase_allocs_per_op[p];
+
+        if ( allocations[p] > 0 && bench->isAllocationFree(phase) )
+        {
+            if ( ! result.failure.isEmpty() )
+                result.failure += ", ";
+            result.failure += QString("%1 allocations in %2").arg(allocations[p]).arg(AllocationCounter::phaseName(phase));
+        }
+    }
+
+    return result;
+}
+
+static QString jsonString(const QString &s)
+{
+    QString escaped = s;
+    escaped.replace("\\","\\\\").replace("\"","\\\"");
+
+    return "\"" + escaped + "\"";
+}
+
+QString BenchRunner::toJson(const QList<BenchResult> &results)
+{
+    QStringList entries;
+
+    foreach (const BenchResult &r, results)
+    {
+        QStringList phases;
+        for (int p = 0; p < allocation_phase_count; p++)
+            phases.append(QString("\"%1\": %2").arg(AllocationCounter::phaseName(AllocationPhase(p))).arg(r.phase_allocs_per_op[p],0,'f',3));
+
+        entries.append(QString("    {\"name\": %1, \"iterations\": %2, \"ns_per_op\": %3, \"min_ns_per_op\": %4, \"allocs_per_op\": %5, \"allocs_per_op_by_phase\": {%6}, \"passed\": %7}")
+                       .arg(jsonString(r.name))
+                       .arg(r.iterations)
+                       .arg(r.ns_per_op,0,'f',2)
+                       .arg(r.min_ns_per_op,0,'f',2)
+                       .arg(r.allocs_per_op,0,'f',3)
+                       .arg(phases.join(", "))
+                       .arg(r.failure.isEmpty() ? "true" : "false"));
+    }
+
+    return QString("{\n  \"qt_version\": %1,\n  \"seed\": %2,\n  \"benchmarks\": [\n%3\n  ]\n}\n")
+            .arg(jsonString(qVersion()))
+            .arg(bench_seed)
+            .arg(entries.join(",\n"));
+}
@@ -0,0 +1,70 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+#include <allocationcounter.h>
+
+const uint bench_seed = 42;
+
+/*
+ * One benchmark case. run() performs one operation and is what gets
+ * measured, setUp() and tearDown() are called once around all runs.
+ * A case fails if it allocates in one of the phases it declared
+ * allocation free.
+ */
+class BenchCase
+{
+public:
+    explicit BenchCase(const QString &name);
+    virtual ~BenchCase();
+
+    virtual void setUp(void);
+    virtual void run(void) = 0;
+    virtual void tearDown(void);
+
+    QString getName(void) const;
+    bool isAllocationFree(AllocationPhase phase) const;
+
+protected:
+    void requireNoAllocations(AllocationPhase phase);
+
+private:
+    QString name;
+    uint allocation_free; // bit mask of phases
+};
+
+struct BenchResult
+{
+    QString name;
+    qint64 iterations;
+    double ns_per_op, min_ns_per_op;
+    double allocs_per_op;
+    double phase_allocs_per_op[allocation_phase_count];
+    QString failure; // empty if the case passed
+};
+
+/*
+ * Runs a case in a number of equally sized batches. The batch size is
+ * doubled until one batch takes min_time / repetitions. The reported time
+ * is the median over the batches, the allocations are averaged over all
+ * operations of all batches.
+ */
+class BenchRunner
+{
+public:
+    explicit BenchRunner(int min_time_ms = 500, int repetitions = 5);
+
+    BenchResult run(BenchCase *bench);
+
+    static QString toJson(const QList<BenchResult> &results);
+
+private:
+    int min_time_ms, repetitions;
+};
+
+// All cases of the suite, see cases.cpp
+QList<BenchCase*> createBenchCases(void);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,507 @@
+#include <benchmark.h>
+#include <localpricegen.h>
+#include <company.h>
+#include <market.h>
+#include <orderbook.h>
+#include <triggerbook.h>
+#include <marginbook.h>
+#include <portfolio.h>
+#include <ledger.h>
+#include <stockpricehistoryplot.h>
+#include <qcustomplot.h>
+#include <QCoreApplication>
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile double sink;
+
+class PriceGenBench : public BenchCase
+{
+public:
+    PriceGenBench() : BenchCase("LocalPriceGen::getPrice") {}
+
+    void setUp(void) { generator.setRange(100); }
+    void run(void) { sink = generator.getPrice(); }
+
+private:
+    LocalPriceGen generator;
+};
+
+class CompanyBench : public BenchCase
+{
+public:
+    CompanyBench() : BenchCase("Company::updatePrice") { requireNoAllocations(phase_price_update); }
+
+    void setUp(void) { company.initCompany(100); }
+
+    void run(void)
+    {
+        ALLOCATION_PHASE(phase_price_update);
+
+        sink = company.updatePrice();
+        if ( sink <= bankruptcy_level * 100 )
+            company.initCompany(100);
+    }
+
+private:
+    Company company;
+};
+
+class MarketTickBench : public BenchCase
+{
+public:
+    explicit MarketTickBench(int n) :
+        BenchCase(QString("Market::tick (%1 tickers)").arg(n)), tickers(n)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void) { market.resize(tickers); }
+    void run(void) { market.tick(); }
+
+private:
+    int tickers;
+};
+
+// One market tick shown by a plot with the given history length (xmax + 1).
+// With 'frame' the tick is also drawn, as render_timer would do. Taking over
+// the tick must not allocate, replot and paint are only measured since
+// QPainter allocates internally.
+class PlotTickBench : public BenchCase
+{
+public:
+    PlotTickBench(int length, bool frame) :
+        BenchCase(QString(frame ? "StockPriceHistoryPlot frame (xmax %1)" : "StockPriceHistoryPlot::setData (xmax %1)").arg(length-1)),
+        length(length), frame(frame), listed(true), plot(0)
+    {
+        requireNoAllocations(phase_price_update);
+        requireNoAllocations(phase_set_data);
+    }
+
+    void setUp(void)
+    {
+        market.resize(1,length);
+        plot = new StockPriceHistoryPlot;
+        plot->resize(800,400);
+        plot->show();
+        plot->bindTicker(0);
+        QCoreApplication::processEvents();
+    }
+
+    void run(void)
+    {
+        market.tick();
+
+        // Rebind after a relisting, as SingleStock does
+        if ( market.isListed(0) && ! listed )
+            plot->bindTicker(0);
+        listed = market.isListed(0);
+
+        plot->setData();
+
+        if ( frame )
+        {
+            plot->render();
+            QCoreApplication::processEvents(); // the queued replot
+        }
+    }
+
+    void tearDown(void)
+    {
+        delete plot;
+        plot = 0;
+    }
+
+private:
+    int length;
+    bool frame, listed;
+    StockPriceHistoryPlot *plot;
+};
+
+// A tick's worth of random limit and market orders around the prices of
+// 100 tickers. Every order cancels the one placed 'resting' orders before,
+// so the books stay at a steady size.
+class MatchingBench : public BenchCase
+{
+public:
+    explicit MatchingBench(int n) :
+        BenchCase(QString("MatchingEngine::match (%1 orders, 100 tickers)").arg(n)),
+        batch(n), next(0), engine(tickers)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void)
+    {
+        engine.resize(tickers);
+        prices.fill(50,tickers);
+        ids.fill(0,4 * batch);
+        next = 0;
+    }
+
+    void run(void)
+    {
+        for (int k = 0; k < batch; k++)
+        {
+            int t = qrand() % tickers;
+            Order::Side side = qrand() % 2 ? Order::Buy : Order::Sell;
+            Order::Type type = qrand() % 10 ? Order::Limit : Order::Market;
+            int price = MatchingEngine::toTicks(prices[t]) + qrand() % 21 - 10;
+
+            engine.cancel(ids[next]);
+            ids[next] = engine.submit(k,t,side,type,1 + qrand() % 100,price);
+            next = (next + 1) % ids.size();
+        }
+
+        // The price moves, so resting orders get crossed as well
+        int t = qrand() % tickers;
+        prices[t] = qBound(40.0,prices[t] + (qrand() % 11 - 5) * price_tick,60.0);
+
+        ALLOCATION_PHASE(phase_price_update);
+        engine.match(prices.constData());
+        engine.clearEvents();
+    }
+
+private:
+    static const int tickers = 100;
+
+    int batch, next;
+    MatchingEngine engine;
+    QVector<double> prices;
+    QVector<qint64> ids;
+};
+
+// 'n' open triggers of all kinds on 100 tickers whose prices all move on
+// every tick. Fired triggers are placed again around the new price, so the
+// book stays at its size.
+class TriggerBench : public BenchCase
+{
+public:
+    explicit TriggerBench(int n) :
+        BenchCase(QString("TriggerBook::evaluate (%1 triggers, 100 tickers)").arg(n)),
+        size(n), book(tickers)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void)
+    {
+        book.resize(tickers);
+        prices.fill(50,tickers);
+
+        for (int k = 0; k < size; k++)
+            place(qrand() % tickers);
+    }
+
+    void run(void)
+    {
+        for (int t = 0; t < tickers; t++)
+            prices[t] = qBound(40.0,prices[t] + (qrand() % 11 - 5) * price_tick,60.0);
+
+        ALLOCATION_PHASE(phase_price_update);
+        book.evaluate(prices.constData());
+
+        for (int k = 0; k < book.eventCount(); k++)
+            place(book.event(k).ticker);
+        book.clearEvents();
+    }
+
+private:
+    void place(int t)
+    {
+        Trigger::Kind kind = Trigger::Kind(qrand() % 3);
+        int price = MatchingEngine::toTicks(prices[t]);
+        int offset = 1 + qrand() % 200;
+
+        if ( kind == Trigger::StopLoss )
+            price -= offset;
+        else if ( kind == Trigger::TakeProfit )
+            price += offset;
+        else
+            price = offset;
+
+        book.place(qrand() % 1000,t,kind,1 + qrand() % 100,price,MatchingEngine::toTicks(prices[t]));
+    }
+
+    static const int tickers = 100;
+
+    int size;
+    TriggerBook book;
+    QVector<double> prices;
+};
+
+// 'n' long and short margin positions of 1000 accounts on 100 tickers whose
+// prices all move on every tick. Liquidated positions are opened again at
+// the new price, so the book stays at its size.
+class MarginBench : public BenchCase
+{
+public:
+    explicit MarginBench(int n) :
+        BenchCase(QString("MarginBook::evaluate (%1 positions, 100 tickers)").arg(n)),
+        size(n), book(tickers,accounts)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void)
+    {
+        book.resize(tickers,accounts);
+        prices.fill(50,tickers);
+
+        for (int k = 0; k < size; k++)
+            open(qrand() % tickers);
+    }
+
+    void run(void)
+    {
+        for (int t = 0; t < tickers; t++)
+            prices[t] = qBound(40.0,prices[t] + (qrand() % 11 - 5) * price_tick,60.0);
+
+        ALLOCATION_PHASE(phase_price_update);
+        book.evaluate(prices.constData());
+
+        for (int k = 0; k < book.eventCount(); k++)
+            open(book.event(k).ticker);
+        book.clearEvents();
+    }
+
+private:
+    // Between the initial margin and three times the value, so some are far from liquidation
+    void open(int t)
+    {
+        int quantity = (1 + qrand() % 100) * (qrand() % 2 ? 1 : -1);
+        Money price = Money::fromDouble(prices[t]);
+        Money collateral = Money::fromDouble(qAbs(quantity) * prices[t] * (initial_margin + (qrand() % 100) / 40.0));
+
+        book.open(qrand() % accounts,t,quantity,price,collateral);
+    }
+
+    static const int tickers = 100;
+    static const int accounts = 1000;
+
+    int size;
+    MarginBook book;
+    QVector<double> prices;
+};
+
+// Marks a portfolio holding 'held' of 10000 tickers, all of which move
+class PortfolioBench : public BenchCase
+{
+public:
+    explicit PortfolioBench(int n) :
+        BenchCase(QString("Portfolio::mark (%1 of 10000 tickers held)").arg(n)),
+        held(n)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void)
+    {
+        portfolio.resize(tickers,default_history_length);
+        prices.fill(50,tickers);
+
+        for (int k = 0; k < held; k++)
+        {
+            int quantity = 1 + qrand() % 100;
+            portfolio.fill(k * (tickers / held),quantity,Money::fromDouble(50),quantity * Money::fromDouble(50));
+        }
+    }
+
+    void run(void)
+    {
+        for (int t = 0; t < tickers; t++)
+            prices[t] = qBound(40.0,prices[t] + (qrand() % 11 - 5) * price_tick,60.0);
+
+        ALLOCATION_PHASE(phase_price_update);
+        portfolio.mark(prices.constData());
+        portfolio.record(0,Money());
+    }
+
+private:
+    static const int tickers = 10000;
+
+    int held;
+    Portfolio portfolio;
+    QVector<double> prices;
+};
+
+// A tick's worth of 'n' fills booked on random accounts of a full ledger,
+// and the flush of the frame
+class LedgerBench : public BenchCase
+{
+public:
+    explicit LedgerBench(int n) :
+        BenchCase(QString("Ledger (%1 updates, %2 accounts)").arg(n).arg(default_ledger_accounts)),
+        updates(n)
+    {
+        requireNoAllocations(phase_price_update);
+    }
+
+    void setUp(void)
+    {
+        for (int k = 0; k < book.size(); k++)
+            book.setBalance(k,Money::fromDouble(10000));
+        book.flush();
+    }
+
+    void run(void)
+    {
+        ALLOCATION_PHASE(phase_price_update);
+
+        for (int k = 0; k < updates; k++)
+        {
+            int account = qrand() % book.size();
+            Money volume = Money::fromUnits(qrand() % 1000000);
+
+            if ( qrand() % 2 )
+                book.credit(account,volume);
+            else if ( ! book.withdraw(account,volume) )
+                book.credit(account,volume);
+        }
+
+        book.flush();
+    }
+
+private:
+    int updates;
+    Ledger book;
+};
+
+// Fills a plot with 'graphs' random walks of 'points' points each
+static QCustomPlot *createPlot(int graphs, int points)
+{
+    QCustomPlot *plot = new QCustomPlot;
+    plot->resize(800,600);
+
+    QVector<double> keys(points), values(points);
+    for (int g = 0; g < graphs; g++)
+    {
+        double value = 50;
+        for (int k = 0; k < points; k++)
+        {
+            keys[k] = k;
+            values[k] = value += (qrand() % 10 - 4.5) / 5;
+        }
+        plot->addGraph()->setData(keys,values);
+    }
+
+    plot->xAxis->setRange(0,points);
+    plot->yAxis->setRange(0,100);
+
+    return plot;
+}
+
+class GraphSetDataBench : public BenchCase
+{
+public:
+    explicit GraphSetDataBench(int n) :
+        BenchCase(QString("QCPGraph::setData (%1 points)").arg(n)), points(n), plot(0) {}
+
+    void setUp(void)
+    {
+        plot = createPlot(1,0);
+        keys.resize(points);
+        values.resize(points);
+        for (int k = 0; k < points; k++)
+        {
+            keys[k] = k;
+            values[k] = qrand() % 100;
+        }
+    }
+
+    void run(void) { plot->graph(0)->setData(keys,values); }
+
+    void tearDown(void)
+    {
+        delete plot;
+        plot = 0;
+    }
+
+private:
+    int points;
+    QCustomPlot *plot;
+    QVector<double> keys, values;
+};
+
+// Appends a point to a sliding window of n points, dropping the oldest one
+class GraphAddDataBench : public BenchCase
+{
+public:
+    explicit GraphAddDataBench(int n) :
+        BenchCase(QString("QCPGraph::addData (window of %1 points)").arg(n)), points(n), plot(0) {}
+
+    void setUp(void)
+    {
+        plot = createPlot(1,points);
+        key = points;
+    }
+
+    void run(void)
+    {
+        plot->graph(0)->addData(key,qrand() % 100);
+        plot->graph(0)->removeDataBefore(key - points + 1);
+        key++;
+    }
+
+    void tearDown(void)
+    {
+        delete plot;
+        plot = 0;
+    }
+
+private:
+    int points;
+    double key;
+    QCustomPlot *plot;
+};
+
+// The plot is never shown, so replot() only draws into its paint buffer
+class ReplotBench : public BenchCase
+{
+public:
+    ReplotBench(int g, int n) :
+        BenchCase(QString("QCustomPlot::replot (%1 graphs, %2 points)").arg(g).arg(n)), graphs(g), points(n), plot(0) {}
+
+    void setUp(void) { plot = createPlot(graphs,points); }
+    void run(void) { plot->replot(); }
+
+    void tearDown(void)
+    {
+        delete plot;
+        plot = 0;
+    }
+
+private:
+    int graphs, points;
+    QCustomPlot *plot;
+};
+
+QList<BenchCase*> createBenchCases(void)
+{
+    QList<BenchCase*> cases;
+
+    cases << new PriceGenBench;
+    cases << new CompanyBench;
+
+    cases << new MarketTickBench(4) << new MarketTickBench(100) << new MarketTickBench(10000);
+
+    cases << new MatchingBench(100) << new MatchingBench(10000);
+    cases << new TriggerBench(1000) << new TriggerBench(50000);
+    cases << new MarginBench(1000) << new MarginBench(50000);
+    cases << new PortfolioBench(10) << new PortfolioBench(1000);
+    cases << new LedgerBench(100) << new LedgerBench(10000);
+
+    const int lengths[] = { 101, 601, 6001 };
+    for (int k = 0; k < 3; k++)
+        cases << new PlotTickBench(lengths[k],false) << new PlotTickBench(lengths[k],true);
+
+    cases << new GraphSetDataBench(1000) << new GraphSetDataBench(100000);
+    cases << new GraphAddDataBench(1000) << new GraphAddDataBench(100000);
+
+    const int graphs[] = { 1, 4, 16 };
+    const int points[] = { 1000, 10000 };
+    for (int g = 0; g < 3; g++)
+        for (int p = 0; p < 2; p++)
+            cases << new ReplotBench(graphs[g],points[p]);
+
+    return cases;
+}
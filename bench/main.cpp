@@ -0,0 +1,91 @@
+#include <benchmark.h>
+#include <market.h>
+#include <ledger.h>
+#include <QApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+
+// The globals of the game that the benchmarked classes refer to
+QTimer main_timer, trend_adapt_timer, render_timer;
+unsigned int main_timer_interval;
+Ledger ledger;
+MetricsRegistry metrics;
+Market market;
+
+/*
+ * Usage: stocktrader-bench [--filter text] [--min-time ms] [--json file]
+ *
+ * Without a display, run it with QT_QPA_PLATFORM=offscreen. Exits with 1
+ * if a steady-state case allocated.
+ */
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    QString filter, json_file;
+    int min_time = 500;
+
+    for (int i = 1; i + 1 < args.size(); i++)
+    {
+        if ( args[i] == "--filter" )
+            filter = args[++i];
+        else if ( args[i] == "--min-time" )
+            min_time = args[++i].toInt();
+        else if ( args[i] == "--json" )
+            json_file = args[++i];
+    }
+
+    QTextStream out(stdout);
+    BenchRunner runner(min_time);
+    QList<BenchResult> results;
+    QList<BenchCase*> cases = createBenchCases();
+    int failed = 0;
+
+    out << QString("%1 %2 %3 %4\n").arg("benchmark",-52).arg("ns/op",12).arg("min ns/op",12).arg("allocs/op",10);
+
+    foreach (BenchCase *bench, cases)
+    {
+        if ( ! filter.isEmpty() && ! bench->getName().contains(filter,Qt::CaseInsensitive) )
+            continue;
+
+        BenchResult r = runner.run(bench);
+        results.append(r);
+
+        out << QString("%1 %2 %3 %4\n")
+               .arg(r.name,-52)
+               .arg(r.ns_per_op,12,'f',1)
+               .arg(r.min_ns_per_op,12,'f',1)
+               .arg(r.allocs_per_op,10,'f',2);
+
+        if ( ! r.failure.isEmpty() )
+        {
+            out << "    FAILED, steady state allocated: " << r.failure << "\n";
+            failed++;
+        }
+        out.flush();
+    }
+
+    qDeleteAll(cases);
+
+    if ( ! json_file.isEmpty() )
+    {
+        QFile file(json_file);
+        if ( ! file.open(QIODevice::WriteOnly | QIODevice::Text) )
+        {
+            out << "Could not write " << json_file << "\n";
+            return 1;
+        }
+        QTextStream(&file) << BenchRunner::toJson(results);
+    }
+
+    if ( failed > 0 )
+    {
+        out << failed << " benchmarks allocated in steady state\n";
+        return 1;
+    }
+
+    return 0;
+}
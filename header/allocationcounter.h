@@ -0,0 +1,85 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+/*
+ * Counts the heap allocations of the process and attributes them to the
+ * phase of the tick and render pipeline that made them. A steady-state
+ * tick is meant to allocate nothing in the price update and set data
+ * phases, the benchmarks fail if it does.
+
+   Only compiled in with "qmake CONFIG+=alloccount" (the benchmarks always
+   have it), otherwise ALLOCATION_PHASE expands to nothing. The phase is
+   per thread and holds for the scope of ALLOCATION_PHASE, nested scopes
+   restore the outer phase. Allocations outside of any scope count as
+   phase_other.
+*/
+
+#ifdef STOCKTRADER_ALLOC_COUNT
+
+#include <QObject>
+#include <QtGlobal>
+
+class QTimer;
+class MetricCounter;
+class MetricHistogram;
+
+enum AllocationPhase
+{
+    phase_other,
+    phase_event,        // bankruptcies, splits, relistings and binding a plot to
+                        // a ticker, allowed to allocate
+    phase_price_update, // Market::tick
+    phase_set_data,     // plots taking over the new tick
+    phase_replot,
+    phase_paint,
+    allocation_phase_count
+};
+
+class AllocationScope
+{
+public:
+    explicit AllocationScope(AllocationPhase phase);
+    ~AllocationScope();
+
+private:
+    AllocationPhase previous;
+};
+
+class AllocationCounter
+{
+public:
+    static quint64 count(void); // all phases
+    static quint64 count(AllocationPhase phase);
+    static const char *phaseName(AllocationPhase phase);
+};
+
+/*
+ * Exposes the allocations as metrics: a counter per phase and the
+ * allocations per frame of the given frame timer.
+ */
+class AllocationMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    AllocationMonitor(QTimer *frame_timer, QObject *parent = 0);
+
+private slots:
+    void frame(void);
+
+private:
+    quint64 last[allocation_phase_count];
+    MetricCounter *phases[allocation_phase_count];
+    MetricHistogram *per_frame;
+};
+
+#define ALLOCATION_CONCAT_(a,b) a##b
+#define ALLOCATION_CONCAT(a,b) ALLOCATION_CONCAT_(a,b)
+#define ALLOCATION_PHASE(phase) AllocationScope ALLOCATION_CONCAT(allocation_scope_,__LINE__)(phase)
+
+#else
+
+#define ALLOCATION_PHASE(phase)
+
+#endif // STOCKTRADER_ALLOC_COUNT
+
+#endif // ALLOCATIONCOUNTER_H
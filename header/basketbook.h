@@ -0,0 +1,76 @@
+#ifndef BASKETBOOK_H
+#define BASKETBOOK_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <money.h>
+
+const double basket_index_base = 100; // the index of a basket when all its tickers first have a price
+
+// Shares of one ticker, per unit of a basket or in a basket order
+struct BasketLeg
+{
+    int ticker;
+    int shares;
+};
+
+/*
+ * Weighted baskets of tickers, e.g. the whole market or a sector, and an
+ * index value of each that follows the prices of its constituents.
+
+   The value of a basket is the sum of shares times price of its legs, in
+   Money, so it never drifts. It is kept incrementally: every ticker knows
+   the baskets it is in (one flat array, rebuilt when a basket is defined),
+   and update() adds the price change of a ticker times its shares to
+   those baskets only. Splits change the shares of the legs instead of the
+   value. The index is the value over a divisor, which is adjusted
+   whenever the value changes for a reason other than prices, i.e. when
+   a ticker gets its first price after a listing or a leg is reweighted,
+   so the index continues where it was.
+*/
+class BasketBook
+{
+public:
+    explicit BasketBook(int tickers = 0);
+
+    void resize(int tickers); // drops all baskets
+
+    int define(const QVector<BasketLeg> &legs); // returns the basket
+    int size(void) const;
+    int legCount(int basket) const;
+    const BasketLeg &leg(int basket, int k) const;
+
+    void split(int ticker, int ratio);
+    void consolidate(int ticker, int ratio);
+    void update(const double *prices); // one price per ticker
+
+    Money value(int basket) const; // of one unit
+    double index(int basket) const; // 0 until the basket has a value
+
+private:
+    struct Membership
+    {
+        int basket;
+        int leg; // index into 'legs'
+    };
+
+    void reweight(int ticker, int num, int den);
+    void rebase(int basket, Money before);
+
+    int tickers;
+
+    // The legs of basket b are legs[first[b]] up to legs[first[b+1]]
+    QVector<BasketLeg> legs;
+    QVector<int> first;
+
+    // The memberships of ticker t are memberships[member_first[t]] up to member_first[t+1]
+    QVector<Membership> memberships;
+    QVector<int> member_first;
+
+    QVector<Money> last; // the price per ticker that the values contain
+    QVector<Money> values;
+    QVector<double> divisors;
+};
+
+#endif // BASKETBOOK_H
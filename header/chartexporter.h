@@ -0,0 +1,46 @@
+#ifndef CHARTEXPORTER_H
+#define CHARTEXPORTER_H
+
+#include <QImage>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QCustomPlot;
+
+const int images_in_flight_per_thread = 2;
+
+/*
+ * Renders the price histories of many tickers to PNG files at the end of
+ * a session, using a pool of worker threads.
+
+   QCustomPlot is a widget and may only be used in the GUI thread, so one
+   offscreen renderer draws the charts there, one after the other, into
+   QImages with QCustomPlot::toImage. Only the encoding and saving of the
+   images runs in parallel in the workers. The renderer waits while
+   images_in_flight_per_thread images per worker are rendered but not yet
+   saved, so memory doesn't grow with the number of charts.
+*/
+class ChartExporter
+{
+public:
+    explicit ChartExporter(int width = 800, int height = 400);
+
+    void addChart(const QString &name, const QVector<double> &prices);
+    int exportCharts(const QString &directory); // returns the number of files written
+
+private:
+    struct Chart
+    {
+        QString name;
+        QVector<double> prices;
+    };
+
+    static QCustomPlot *createRenderer(void);
+    static QImage renderChart(QCustomPlot *renderer, const Chart &chart, int width, int height);
+
+    int width, height;
+    QList<Chart> charts;
+};
+
+#endif // CHARTEXPORTER_H
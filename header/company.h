@@ -3,10 +3,17 @@
 
 #include <QObject>
 #include <localpricegen.h>
+#include <money.h>
+#include <lotqueue.h>
 
 /*
  * Just again a quite misleading name: This class represents the price
  * of a company along with its representation in the user's depot.
+ * Prices and the depot are fixed-point Money. The depot keeps the lots
+ * it bought, a sale relieves them by the cost basis method and returns
+ * their purchase value, so the realized P&L is exact per lot.
+ * Corporate actions are decided and scheduled by the market, which only
+ * calls in here to apply them to the price and the depot.
  */
 class Company
 {
@@ -15,27 +22,36 @@ public:
 
     void initCompany(double ymax = 100);
 
-    double getPrice(void);
+    Money getPrice(void);
+    int getShares(void);
+    Money getAvgPrice(void);
     void recalcAvg(void);
-    void buy(int);
-    void sell(int);
+    void buy(int, Money price);
+    Money sell(int); // returns the purchase value of the sold shares
+    void setCostBasis(CostBasis method);
+    const LotQueue &getLots(void) const;
 
     double updatePrice(void);
 
+    void split(int ratio);
+    void consolidate(int ratio); // the depot must hold a multiple of 'ratio'
+    void exDividend(Money amount); // per share
+    void delist(void);
+
 private:
-    void split(void);
+    void setPrice(Money price);
 
     LocalPriceGen price_generator;
 
-    double current_price;
+    Money current_price;
     int shares_in_depot;
-    double total_value;
-    double avg_depot_price;
+    LotQueue lots;
+    Money avg_depot_price;
     int ymax;
-    bool is_bankrupt, splitted;
 
     friend class StockPriceHistoryPlot;
     friend class SingleStock;
+    friend class Market;
 };
 
 #endif // COMPANY_H
@@ -0,0 +1,56 @@
+#ifndef CORPORATEACTIONS_H
+#define CORPORATEACTIONS_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Price levels as fractions of the range of the price generator
+const double split_level = 0.97;         // splits 2 for 1 at or above
+const double reverse_split_level = 0.05; // announces a reverse split, 2 into 1, at or below
+const double bankruptcy_level = 0.02;    // delists at or below
+
+const int split_ratio = 2;
+const int reverse_split_notice = 20; // ticks from the announcement, the company may go bankrupt meanwhile
+const int dividend_interval = 250;  // ticks between the dividends of a company
+const double dividend_yield = 0.005; // of the price, paid per share
+
+struct CorporateAction
+{
+    enum Type { Split, ReverseSplit, Dividend, Delisting, Listing };
+
+    int tick; // applied with the actions of this tick
+    int ticker;
+    Type type;
+    int ratio;   // new shares per old one for splits, old ones per new one for reverse splits
+    int listing; // the listing of the ticker it is meant for, see Market::list()
+    qint64 sequence;
+};
+
+/*
+ * The scheduled corporate actions of all tickers, ordered by the tick they
+ * are due at and the order they were scheduled in.
+
+   A binary min-heap in a vector, so scheduling and taking an action are
+   O(log n). The actions of a company that has been delisted in the
+   meantime aren't searched for, the market drops them when they are taken
+   because their listing doesn't match the current one.
+*/
+class CorporateActions
+{
+public:
+    CorporateActions(void);
+
+    void clear(int capacity); // reserves room for 'capacity' pending actions
+
+    void schedule(int tick, int ticker, CorporateAction::Type type, int listing, int ratio = 1);
+    bool due(int tick) const; // whether an action is due at or before 'tick'
+    CorporateAction take(void); // the next one, only if there is one
+
+    int size(void) const;
+
+private:
+    QVector<CorporateAction> heap;
+    qint64 sequence;
+};
+
+#endif // CORPORATEACTIONS_H
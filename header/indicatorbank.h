@@ -0,0 +1,49 @@
+#ifndef INDICATORBANK_H
+#define INDICATORBANK_H
+
+#include <QVector>
+
+/*
+ * Technical indicators (SMA, EMA, Bollinger bands and RSI) for a number of
+ * tickers that are all updated at the same tick.
+
+   Every indicator is kept up to date with O(1) work per tick from running
+   sums and a ring buffer of the last 'period' prices. The state is stored
+   as one array per quantity indexed by ticker (the ring buffer row by row),
+   so a whole market batch is processed in plain loops over contiguous memory.
+*/
+class IndicatorBank
+{
+public:
+    enum Indicator { SMA, EMA, UpperBand, LowerBand, RSI };
+
+    explicit IndicatorBank(int tickers = 1, int period = 20, double band_width = 2);
+
+    void resize(int tickers);
+    void reset(int ticker);
+    void scale(int ticker, double factor); // e.g. 0.5 after a split
+
+    void update(const double *prices); // one price per ticker, tickers at 0 are skipped
+
+    double value(Indicator, int ticker = 0) const;
+    bool isReady(int ticker = 0) const;
+
+    int getPeriod(void) const;
+    int tickerCount(void) const;
+
+private:
+    void resync(void);
+
+    int tickers, period;
+    double band_width, ema_alpha;
+
+    // The ring buffer is period rows of 'tickers' prices, head is the row written next.
+    QVector<double> window;
+    int head;
+
+    QVector<int> count;
+    QVector<double> sum, sum_sq, ema, last_price, avg_gain, avg_loss;
+    QVector<double> sma, upper_band, lower_band, rsi;
+};
+
+#endif // INDICATORBANK_H
@@ -0,0 +1,62 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <QObject>
+#include <QtGlobal>
+#include <atomic>
+
+#include <money.h>
+
+const int default_ledger_accounts = 1024; // the player is account 0, the others are bots
+const int cache_line_size = 64;
+
+/*
+ * The cash of all accounts, the player's and those of the bots.
+
+   Every balance is an atomic count of Money units, so credits are a single
+   fetch-and-add and withdrawals a compare-and-swap loop that never takes
+   a balance below zero, from any thread and without a lock. Each account
+   fills a cache line of its own, the array is allocated aligned to them,
+   so threads updating different accounts don't slow each other down.
+
+   Changes only mark their account. flush() is called once per frame and
+   emits balanceChanged() once for every account that changed since the
+   last one, however often it changed.
+*/
+class Ledger : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Ledger(int accounts = default_ledger_accounts, QObject *parent = 0);
+    ~Ledger();
+
+    void resize(int accounts); // only while nobody uses it, all balances are 0 after it
+    int size(void) const;
+    bool contains(int account) const;
+
+    Money balance(int account) const;
+    void setBalance(int account, Money amount);
+    void credit(int account, Money amount); // negative amounts are debited
+    bool withdraw(int account, Money amount); // only if the balance covers it
+    bool transfer(int from, int to, Money amount); // likewise
+
+signals:
+    void balanceChanged(int account, double balance); // for display only
+
+public slots:
+    void flush(void);
+
+private:
+    struct alignas(cache_line_size) Account
+    {
+        std::atomic<qint64> units;
+        std::atomic<bool> changed;
+    };
+
+    Account *accounts;
+    int account_count;
+};
+
+extern Ledger ledger;
+
+#endif // LEDGER_H
@@ -0,0 +1,75 @@
+#ifndef LOTQUEUE_H
+#define LOTQUEUE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <money.h>
+
+const qint64 max_split_factor = Q_INT64_C(1) << 32; // folded into the lots beyond this
+
+// Which shares a sale takes out of the depot
+enum CostBasis { Fifo, Lifo, AverageCost };
+
+// Shares bought together. The quantity is counted in shares of the time
+// when the cumulative split factor was 'factor'.
+struct Lot
+{
+    qint64 quantity;
+    qint64 factor;
+    Money cost; // purchase value of the whole lot, splits don't change it
+};
+
+/*
+ * The lots of one depot position in the order they were bought, and the
+ * relief of sold shares from them by the cost basis method.
+
+   The lots are a ring buffer that only grows when it is full, so a buy
+   appends in O(1) and a sale takes lots from the front (FIFO) or the back
+   (LIFO), touching only the lots it relieves. With average cost all
+   shares are pooled in one lot and a sale takes its part of the value.
+
+   A split only multiplies the cumulative split factor. The quantity of a
+   lot is brought to the current factor when a sale touches it, the lot
+   cost stays as it is, so splits are O(1) no matter how many lots exist.
+   Reverse splits are rare and can't be deferred like that, they rewrite
+   every lot once. That and an empty depot set the factor back to 1, and
+   so does a split that would take it past max_split_factor, so it never
+   overflows.
+*/
+class LotQueue
+{
+public:
+    LotQueue(void);
+
+    void clear(void);
+    void setMethod(CostBasis method); // pools the lots for AverageCost
+    CostBasis getMethod(void) const;
+
+    void buy(int quantity, Money cost);
+    Money sell(int quantity); // returns the purchase value of the sold shares
+    void split(int ratio = 2);
+    void consolidate(int ratio); // the shares must be a multiple of 'ratio'
+
+    int shares(void) const;
+    Money cost(void) const;
+    int lotCount(void) const;
+    Lot lot(int k) const; // oldest first, at the current split factor
+
+private:
+    Lot &at(int k);
+    void normalize(Lot &lot) const;
+    void rebase(void);
+    Money relieve(Lot &lot, qint64 &quantity);
+    void append(const Lot &lot);
+
+    QVector<Lot> ring;
+    int head, count;
+
+    qint64 factor;
+    int share_count;
+    Money total_cost;
+    CostBasis method;
+};
+
+#endif // LOTQUEUE_H
@@ -6,13 +6,19 @@
 #include <QTimer>
 
 #include "stockpricehistoryplot.h"
-#include "moneyavailable.h"
+#include "ledger.h"
+#include "marketmodel.h"
+#include "sparklinedelegate.h"
+#include "metrics.h"
+#include "metricsserver.h"
 
 const int default_initial_money = 10000;
 const int max_interval = 400;
+const int default_frame_rate = 60;
 extern unsigned int main_timer_interval;
 
-extern QTimer main_timer, trend_adapt_timer;
+// main_timer drives the simulation, render_timer the drawing of the views
+extern QTimer main_timer, trend_adapt_timer, render_timer;
 
 namespace Ui {
 class MainWindow;
@@ -37,15 +43,31 @@ public slots:
     void continueGame(void);
     void seed(void);
     void changeInterval(int);
+    void changeMarketSize(int);
+    void changeFrameRate(int);
+    void changeCostBasis(int);
+    void buyBasket(void);
+    void sellBasket(void);
 
 private slots:
     void afterGameFinished(void);
+    void stopRendering(void);
+    void dumpTrace(void);
+    void showPortfolio(void);
+    void showBalance(int account, double balance);
 
 private:
+    void exportCharts(void);
+    void setBackgroundTimers(bool running);
 
    Ui::MainWindow *ui;
 
    QTimer reseed_timer;
+   MarketModel market_model;
+   SparklineDelegate sparkline_delegate;
+
+   MetricsServer metrics_server;
+   TimerMonitor main_timer_monitor, render_timer_monitor;
 
 };
 
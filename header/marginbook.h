@@ -0,0 +1,106 @@
+#ifndef MARGINBOOK_H
+#define MARGINBOOK_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <money.h>
+#include <triggerbook.h>
+
+const int margin_pool_size = 1 << 16; // open positions of all accounts together
+const int margin_index_bits = 20;     // low bits of a position id, the pool index
+const double initial_margin = 0.5;      // collateral per value of the shares when opening, i.e. 2x leverage
+const double maintenance_margin = 0.25; // equity per value of the shares below which a position is liquidated
+
+// Shares bought with borrowed money or sold short, backed by collateral
+struct MarginPosition
+{
+    qint64 id; // 0 while the slot is free
+    int account, ticker;
+    int quantity; // negative for short positions
+    Money entry;  // price per share it was opened at
+    Money collateral;
+    qint64 liquidation; // price in Money units where the equity reaches the maintenance margin
+    int prev, next;     // the ring of the positions of the account, 'next' links the free list too
+    int ticker_prev, ticker_next; // the ring of the positions of the ticker
+};
+
+// A position that was closed, its equity goes back to the account
+struct MarginEvent
+{
+    enum Reason { Closed, Liquidated };
+
+    qint64 position;
+    int account, ticker;
+    Reason reason;
+    int quantity;
+    Money price;
+    Money payout; // never negative, a loss beyond the collateral is the lender's
+};
+
+/*
+ * Margin positions of all accounts, long ones on borrowed money and short
+ * ones on borrowed shares, each with its own collateral.
+
+   The equity of a position is its collateral plus the quantity times the
+   price change since it was opened. It is liquidated once the equity
+   falls below maintenance_margin of the value of its shares, which
+   happens at a price that only changes when the position does. Like the
+   stop-losses and take-profits of TriggerBook, the long positions of a
+   ticker are a max-heap by that price and the short ones a min-heap, so a
+   tick compares the price with the two roots and only touches the
+   positions it crossed, no matter how many accounts there are. The
+   positions of a ticker are linked in a ring too, so corporate actions
+   and closing them all only walk that ticker's positions.
+*/
+class MarginBook
+{
+public:
+    explicit MarginBook(int tickers = 0, int accounts = 0);
+
+    void resize(int tickers, int accounts); // drops all positions
+
+    // Returns the id of the position or 0 if the collateral is below the
+    // initial margin or the pool is full
+    qint64 open(int account, int ticker, int quantity, Money price, Money collateral);
+    bool close(qint64 id, Money price);
+    void closeAll(int ticker, Money price, int account = -1); // of all accounts by default
+    void split(int ticker, int ratio);
+    void consolidate(int ticker, int ratio, Money price); // closes the positions left without a share
+
+    void evaluate(const double *prices); // one price per ticker
+
+    const MarginPosition *position(qint64 id) const; // 0 if it isn't open
+    Money equity(int account, const double *prices) const; // of all positions of the account
+    int quantity(int account, int ticker) const; // net over the positions of the account
+
+    // Closed positions since the last clearEvents()
+    int eventCount(void) const;
+    const MarginEvent &event(int k) const;
+    void clearEvents(void);
+
+private:
+    int find(qint64 id) const;
+    void push(int position);
+    void rebuild(int ticker);
+    void settle(int position, Money price, MarginEvent::Reason reason);
+    void unlink(int position);
+
+    int tickers;
+    qint64 sequence;
+
+    QVector<MarginPosition> positions;
+    int free_positions;
+    PairingHeaps heaps;
+
+    // Heap roots per ticker, short ones keyed by the negated price
+    QVector<int> longs, shorts;
+
+    QVector<int> account_positions; // a position of every account, -1 if it has none
+    QVector<int> ticker_positions;  // likewise of every ticker
+
+    QVector<MarginEvent> events; // a position closes once, so the pool size is enough
+    int event_count;
+};
+
+#endif // MARGINBOOK_H
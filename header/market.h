@@ -0,0 +1,187 @@
+#ifndef MARKET_H
+#define MARKET_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include <basketbook.h>
+#include <company.h>
+#include <corporateactions.h>
+#include <indicatorbank.h>
+#include <marginbook.h>
+#include <metrics.h>
+#include <orderbook.h>
+#include <portfolio.h>
+#include <riskbank.h>
+#include <triggerbook.h>
+
+const int default_market_size = 4;
+const int default_history_length = 601;
+const int relist_delay = 60; // ticks a bankrupt ticker stays delisted
+const int player_account = 0; // whose fills go to the depots of the companies, see Ledger
+const int market_basket = 0; // one share of every ticker
+const double market_order_protection = 0.01; // market orders of the player fill at most 1% off the price they saw
+
+/*
+ * The backing store of all tickers of the game. It owns the companies and
+ * keeps their prices and price histories in flat arrays, one row per ticker.
+
+   All tickers are simulated on every tick, no matter whether a panel shows
+   them. The views (SingleStock, StockPriceHistoryPlot) only read from here.
+   Orders go to the matching engine and are executed in the next tick, the
+   cash and shares of open orders of the player are reserved until then.
+   Buy orders of the other accounts of the ledger take their cost out of
+   the ledger when they are submitted, what the fill doesn't use comes
+   back with it, so no balance goes below zero.
+   Triggers are evaluated on the new prices before the orders are matched,
+   the ones that fire become market sell orders of the same tick.
+   Corporate actions (splits, reverse splits, dividends, delistings and
+   listings) are scheduled for a tick, and all that are due are applied
+   together after the new prices, before the triggers. The tick itself
+   only checks whether a price left the band between the reverse split
+   and split levels, other actions are due by time, so none of them costs
+   anything on the ticks it isn't due. Their signals are emitted after
+   ticked().
+   Basket orders of the player buy or sell the shares of all legs of a
+   basket at once. They are checked against the cash once, executed in the
+   next tick after the orders and cancelled as a whole if a leg can't be
+   filled or the total moved past the protection.
+   Margin positions are opened and closed at the price of the last tick.
+   Every tick liquidates the ones whose price crossed their liquidation
+   price, right after the corporate actions, and pays what is left of
+   their equity back to the ledger.
+   The price history of a ticker is a ring of historyLength() prices. All
+   tickers share the ring position, which is the one returned by cursor(),
+   with the valuation of the player's portfolio.
+*/
+class Market : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Market(QObject *parent = 0);
+    ~Market();
+
+    void resize(int tickers, int length = default_history_length);
+    int size(void) const;
+
+    Company *company(int ticker);
+    QString name(int ticker) const;
+    double price(int ticker) const;
+    double openPrice(int ticker) const;
+    bool isListed(int ticker) const;
+
+    int getTickCount(void) const;
+    qint64 getLastTickTime(void) const;
+    int historyLength(void) const;
+    int cursor(void) const;
+    int lastPosition(void) const;
+    int historySize(int ticker) const;
+    const double *history(int ticker) const;
+    QVector<double> priceHistory(int ticker) const;
+
+    const IndicatorBank &getIndicators(void) const;
+
+    // Return the order id or 0 if the order was rejected
+    qint64 submitOrder(int ticker, int account, Order::Side side, Order::Type type, int quantity, double price = 0);
+    bool cancelOrder(qint64 id);
+    const MatchingEngine &getMatchingEngine(void) const;
+    const Portfolio &getPortfolio(void) const;
+    const RiskBank &getRisk(void) const;
+    const BasketBook &getBaskets(void) const;
+
+    // Of the player, 'units' times the shares of every leg
+    bool submitBasketOrder(int basket, Order::Side side, int units);
+
+    // Long (positive quantity) or short position with initial_margin of its
+    // value as collateral from the ledger. Returns its id or 0.
+    qint64 openPosition(int ticker, int account, int quantity);
+    bool closePosition(qint64 id);
+    void closePositions(int ticker, int account);
+    const MarginBook &getMargin(void) const;
+
+    // Stop-loss, take-profit and trailing-stop triggers on holdings. The
+    // price of a trailing stop is its distance below the peak.
+    qint64 placeTrigger(int ticker, int account, Trigger::Kind kind, int quantity, double price);
+    bool cancelTrigger(qint64 id);
+    void cancelTriggers(int ticker, int account);
+
+    Money availableCash(void) const; // of the player, minus open buy orders
+    int availableShares(int ticker) const;
+
+    void setCostBasis(CostBasis method); // of the depots of all companies
+
+signals:
+    void resized(void);
+    void ticked(void);
+    void bankrupt(int);
+    void splitted(int); // reverse splits too
+    void relisted(int);
+    void depotChanged(int); // orders of the player were filled
+    void basketFilled(int); // the depots of all legs changed
+    void marginCall(int); // a position of the player was liquidated
+
+public slots:
+    void tick(void);
+
+private:
+    void list(int ticker);
+    void breach(int ticker);
+    void applyActions(void);
+    void split(int ticker, int ratio);
+    void consolidate(int ticker, int ratio);
+    void payDividend(int ticker);
+    void delist(int ticker);
+    void adjustHistories(void);
+    void announceActions(void);
+    void fireTriggers(void);
+    void settleOrders(void);
+    void executeBasketOrders(void);
+    void settleMargin(void);
+    QString newCompanyName(void);
+
+    QList<Company*> companies;
+    QVector<QString> names;
+    QVector<double> prices, opens, price_history;
+    QVector<int> age;
+    IndicatorBank indicators;
+    int history_length, position, tick_count;
+
+    MatchingEngine matching;
+    TriggerBook triggers;
+    MarginBook margin;
+    Portfolio portfolio;
+    RiskBank risk;
+    Money reserved_cash;
+    QVector<int> reserved_shares;
+    CostBasis cost_basis;
+
+    CorporateActions actions;
+    QVector<int> listings;        // counts the listings and delistings of every ticker
+    QVector<bool> listed;
+    QVector<double> floors, ceilings; // prices that schedule an action
+    QVector<double> adjustments;  // split factors of the history rows in this tick, 1 if none
+    QVector<int> adjusted;        // the tickers with one
+    QVector<CorporateAction> applied; // to be announced after ticked()
+    QVector<int> action_ticks; // when the last action of a ticker was applied
+
+    struct BasketOrder
+    {
+        int basket;
+        Order::Side side;
+        Money limit; // the most a buy may cost, the least a sale must bring
+        int first, count; // its legs in basket_order_legs, shares are quantities
+    };
+
+    BasketBook baskets;
+    QVector<BasketOrder> basket_orders;
+    QVector<BasketLeg> basket_order_legs;
+
+    MetricHistogram *tick_time;
+    qint64 last_tick_time;
+};
+
+extern Market market;
+
+#endif // MARKET_H
@@ -0,0 +1,59 @@
+#ifndef MARKETMODEL_H
+#define MARKETMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+/*
+ * Table model of the whole market: one row per ticker with the symbol,
+ * last price, change since listing, shares held, average depot price, P&L
+ * and the volatility, maximum drawdown and VaR of the price.
+ * The trend column has no text, it is drawn by a SparklineDelegate, and the
+ * ticker of a row is available in Qt::UserRole.
+
+   The data is read straight from the market. Market ticks only mark the
+   model dirty, the views are notified with a single dataChanged() over
+   all rows once per frame of render_timer. When sorted, the row order is repaired by an
+   insertion sort over the previous order, which is nearly sorted already.
+*/
+class MarketModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column { Symbol, Last, Change, Shares, AvgPrice, ProfitLoss, Volatility, MaxDrawdown, ValueAtRisk, Trend, ColumnCount };
+
+    explicit MarketModel(QObject *parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+    int tickerAt(int row) const;
+
+public slots:
+    void resetMarket(void);
+    void marketTicked(void);
+
+private slots:
+    void flush(void);
+
+private:
+    double value(int column, int ticker) const;
+    bool lessThan(int a, int b) const;
+    void updateKeys(void);
+    void reorder(bool full);
+
+    bool dirty;
+
+    // row -> ticker, only differs from the identity when sorted
+    QVector<int> row_ticker;
+    QVector<double> keys;
+    int sort_column;
+    Qt::SortOrder sort_order;
+
+    friend struct MarketModelLess;
+};
+
+#endif // MARKETMODEL_H
@@ -0,0 +1,112 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+class QTimer;
+
+/*
+ * In-process metrics: counters and latency histograms, registered by name
+ * in the global registry 'metrics' and scraped through a MetricsServer.
+
+   Recording is a few relaxed atomic increments, so it is cheap enough for
+   every tick and frame and safe from any thread. Durations are recorded
+   in nanoseconds and exposed in seconds.
+*/
+
+class MetricCounter
+{
+public:
+    MetricCounter(void);
+
+    void add(quint64 n = 1);
+    quint64 value(void) const;
+
+private:
+    std::atomic<quint64> count;
+};
+
+// Buckets with 4 significant bits (HDR histogram style): exact below 16,
+// above that 16 buckets per power of two, i.e. at most 6.25% relative error.
+const int histogram_sub_buckets = 16;
+const int histogram_buckets = (64 - 4 + 1) * histogram_sub_buckets;
+
+class MetricHistogram
+{
+public:
+    MetricHistogram(void);
+
+    void record(quint64 value);
+
+    quint64 count(void) const;
+    quint64 sum(void) const;
+    quint64 max(void) const;
+    quint64 quantile(double q) const;
+
+private:
+    static int bucketIndex(quint64 value);
+    static quint64 bucketMidpoint(int index);
+
+    std::atomic<quint64> buckets[histogram_buckets];
+    std::atomic<quint64> total, value_sum, value_max;
+};
+
+class MetricsRegistry
+{
+public:
+    ~MetricsRegistry();
+
+    // Returns the already registered metric if the name is known. The
+    // recorded values of a histogram are exposed multiplied by 'scale'.
+    MetricCounter *counter(const QString &name, const QString &help);
+    MetricHistogram *histogram(const QString &name, const QString &help, double scale = 1e-9);
+
+    QString exposition(void);
+
+    static qint64 now(void); // monotonic clock in ns
+
+private:
+    struct Entry
+    {
+        QString name, help;
+        MetricCounter *counter;
+        MetricHistogram *histogram;
+        double scale;
+    };
+
+    Entry *find(const QString &name);
+
+    QMutex mutex;
+    QList<Entry> entries;
+};
+
+extern MetricsRegistry metrics;
+
+/*
+ * Counts the timeouts of a repeating timer that came late, i.e. more than
+ * half an interval after they were due, and the timeouts that were lost
+ * completely because the event loop was busy.
+ */
+class TimerMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    TimerMonitor(QTimer *timer, const QString &name, QObject *parent = 0);
+
+public slots:
+    void restart(void); // the timer was (re)started, forget the last timeout
+
+private slots:
+    void timeout(void);
+
+private:
+    QTimer *timer;
+    qint64 last;
+    MetricCounter *events, *late, *missed;
+};
+
+#endif // METRICS_H
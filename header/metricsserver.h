@@ -0,0 +1,34 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QLocalServer>
+
+/*
+ * Serves the metrics registry on a local (Unix domain) socket, for the
+ * monitoring agent to scrape.
+
+   Every request gets the current exposition text and the connection is
+   closed. A request starting with "GET" (e.g. curl --unix-socket) is
+   answered as HTTP, anything else (e.g. a newline from socat) as plain text.
+*/
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject *parent = 0);
+
+    bool listen(const QString &path);
+    QString socketPath(void) const;
+
+    static QString defaultPath(void);
+
+private slots:
+    void newConnection(void);
+    void request(void);
+
+private:
+    QLocalServer server;
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,57 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <QtGlobal>
+
+const qint64 money_scale = 10000; // units per 1.0, i.e. 1e-4 units of money
+
+/*
+ * Fixed-point amount of money or price, a whole number of 1e-4 units.
+ * Depot accounting and the ledger use it, so adding, subtracting and
+ * multiplying by share counts is exact and gives the same result on every
+ * machine. Doubles only come in from the price generator, rounded to the
+ * nearest unit, and go out to the views.
+*/
+class Money
+{
+public:
+    Money(void) : units(0) {}
+
+    static Money fromUnits(qint64 units) { Money m; m.units = units; return m; }
+    static Money fromDouble(double value) { return fromUnits(qRound64(value * money_scale)); }
+
+    qint64 toUnits(void) const { return units; }
+    double toDouble(void) const { return double(units) / money_scale; }
+
+    // this * num / den, truncated towards zero, without overflowing as
+    // long as num * den does not
+    Money mulDiv(qint64 num, qint64 den) const
+    {
+        return fromUnits(units / den * num + units % den * num / den);
+    }
+
+    Money operator-(void) const { return fromUnits(-units); }
+    Money operator+(Money m) const { return fromUnits(units + m.units); }
+    Money operator-(Money m) const { return fromUnits(units - m.units); }
+    Money operator*(qint64 n) const { return fromUnits(units * n); }
+    Money operator/(qint64 n) const { return fromUnits(units / n); }
+    Money &operator+=(Money m) { units += m.units; return *this; }
+    Money &operator-=(Money m) { units -= m.units; return *this; }
+
+    bool operator==(Money m) const { return units == m.units; }
+    bool operator!=(Money m) const { return units != m.units; }
+    bool operator<(Money m) const { return units < m.units; }
+    bool operator<=(Money m) const { return units <= m.units; }
+    bool operator>(Money m) const { return units > m.units; }
+    bool operator>=(Money m) const { return units >= m.units; }
+
+private:
+    qint64 units;
+};
+
+inline Money operator*(qint64 n, Money m)
+{
+    return m * n;
+}
+
+#endif // MONEY_H
@@ -0,0 +1,139 @@
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <money.h>
+
+const int order_pool_size = 1 << 16;  // open orders of all tickers together
+const int order_queue_size = 1 << 16; // orders and cancels submitted between two ticks
+const int order_index_bits = 20;      // low bits of an order id, the pool index
+const double price_tick = 0.01;       // book prices are whole multiples of it
+const int maker_half_spread = 1;      // in price ticks around the simulated price
+
+struct PriceLevel;
+
+struct Order
+{
+    enum Side { Buy, Sell };
+    enum Type { Limit, Market };
+
+    qint64 id; // 0 while the node is free
+    int account, ticker;
+    Side side;
+    Type type;
+    int price;    // in price ticks, for market orders the worst acceptable price
+    int quantity; // still open
+
+    Order *prev, *next; // in the queue of its price level, or the free list
+    PriceLevel *level;  // 0 until the order rests in the book
+};
+
+struct PriceLevel
+{
+    int price;
+    qint64 quantity; // of all orders of the level
+    Order *head, *tail;
+    PriceLevel *prev, *next; // towards the better and the worse prices
+};
+
+// Execution report of one order, for the account that placed it
+struct OrderEvent
+{
+    qint64 order;
+    int account, ticker;
+    Order::Side side;
+    int limit;     // of the order, in price ticks
+    int filled;    // quantity filled by this event ...
+    int price;     // ... at this price
+    int cancelled; // quantity cancelled by this event
+    int remaining; // quantity still open after it, 0 once the order is done
+};
+
+/*
+ * Limit order books of all tickers with price-time priority, and the
+ * engine that matches them once per market tick.
+
+   Orders and price levels are intrusive list nodes taken from pools that
+   are allocated once, so submitting, matching and cancelling never
+   allocate. The levels of each side form a list sorted from the best
+   price on, so the best bid and ask are the heads of the lists. A new
+   level is linked in by walking from the best price, which is short since
+   most orders are placed near the touch.
+
+   Orders and cancels are only queued by submit() and cancel(), match()
+   executes them in the market tick. The simulated price of a ticker acts
+   as a market maker with unlimited quantity, quoting maker_half_spread
+   below and above it: what the book can't fill is filled at the quote if
+   the limit allows it, and resting orders are filled at their limit once
+   the quote crosses it. Orders inside the spread are matched against each
+   other first.
+*/
+class MatchingEngine
+{
+public:
+    explicit MatchingEngine(int tickers = 0);
+
+    void resize(int tickers); // drops all orders
+
+    // Return the id of the order or 0 if it was rejected, e.g. a full pool.
+    // For market orders a price of 0 means that any price is accepted.
+    qint64 submit(int account, int ticker, Order::Side side, Order::Type type, int quantity, int price = 0);
+    bool cancel(qint64 id);
+    void cancelAll(int ticker); // immediately, e.g. on a bankruptcy
+
+    void match(const double *prices); // one simulated price per ticker
+
+    // Execution reports since the last clearEvents()
+    int eventCount(void) const;
+    const OrderEvent &event(int k) const;
+    void clearEvents(void);
+
+    int bestBid(int ticker) const; // in price ticks, 0 if there is none
+    int bestAsk(int ticker) const;
+
+    static int toTicks(double price);
+    static double fromTicks(int ticks);
+    static Money toMoney(int ticks); // exact
+
+private:
+    struct Command
+    {
+        qint64 id;
+        bool cancel;
+    };
+
+    Order *find(qint64 id);
+    void execute(Order *order, int market_price);
+    void fillLevel(PriceLevel *level, Order *order);
+    void fill(Order *order, int quantity, int price);
+    void cancelOrder(Order *order);
+    void cross(int ticker, int market_price);
+    void rest(Order *order);
+    void unlink(Order *order);
+    void close(Order *order);
+    void report(const Order *order, int filled, int price, int cancelled);
+    void enqueue(qint64 id, bool cancel);
+
+    int tickers;
+
+    QVector<Order> orders;
+    QVector<PriceLevel> levels;
+    Order *free_orders;
+    PriceLevel *free_levels;
+    qint64 sequence;
+
+    // Best level of each side, per ticker
+    QVector<PriceLevel*> bids, asks;
+
+    QVector<Command> queue; // ring buffer
+    int queue_head, queue_size;
+
+    // Every event closes an order or a counterparty of it, so twice the
+    // pool size is enough for one tick.
+    QVector<OrderEvent> events;
+    int event_count;
+};
+
+#endif // ORDERBOOK_H
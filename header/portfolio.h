@@ -0,0 +1,68 @@
+#ifndef PORTFOLIO_H
+#define PORTFOLIO_H
+
+#include <QVector>
+
+#include <money.h>
+
+// One point of the valuation time series, taken at the end of a tick
+struct PortfolioSample
+{
+    Money equity;     // cash plus the holdings at their last price
+    Money unrealized; // of the holdings against their purchase value
+    Money realized;   // since the start of the game
+};
+
+/*
+ * Mark-to-market valuation of the holdings of the player: the exposure
+ * per ticker, the total value and the realized and unrealized P&L.
+
+   Nothing is recomputed from scratch. Fills, splits and write-offs adjust
+   the ticker they happen to, and mark() only visits the held tickers and
+   adds the price change times the shares of those whose price moved, so a
+   tick costs O(held tickers) no matter how large the market is. Sold
+   shares take the purchase value along that the lots of the depot
+   relieved for them (see LotQueue), so the realized P&L follows the cost
+   basis method.
+*/
+class Portfolio
+{
+public:
+    explicit Portfolio(int tickers = 0, int length = 0);
+
+    void resize(int tickers, int length); // drops all holdings and samples
+
+    // Positive quantities are bought, 'cost' is their purchase value
+    void fill(int ticker, int quantity, Money price, Money cost);
+    void split(int ticker, int ratio = 2);
+    void consolidate(int ticker, int ratio); // after the odd shares were sold
+    void dividend(int ticker, Money amount); // per share, realized right away
+    void writeOff(int ticker); // the company went bankrupt
+
+    void mark(const double *prices); // one price per ticker
+    void record(int position, Money cash); // samples the ring at 'position'
+
+    int shares(int ticker) const;
+    Money exposure(int ticker) const; // value of the holding at its last price
+    Money holdingsValue(void) const;
+    Money unrealized(void) const;
+    Money realized(void) const;
+
+    const PortfolioSample &sample(int position) const;
+
+private:
+    void rescale(int ticker, qint64 shares, Money mark);
+    void hold(int ticker, Money price);
+    void release(int ticker);
+
+    QVector<int> share_count;
+    QVector<Money> marks, values, costs;
+    Money holdings_value, cost_total, realized_total;
+
+    // The tickers with shares, and the index of each in it or -1
+    QVector<int> held, held_index;
+
+    QVector<PortfolioSample> samples;
+};
+
+#endif // PORTFOLIO_H
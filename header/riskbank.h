@@ -0,0 +1,79 @@
+#ifndef RISKBANK_H
+#define RISKBANK_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+
+struct RiskSnapshot
+{
+    double volatility;    // standard deviation of the returns per tick
+    double drawdown;      // below the highest value, as a fraction of it
+    double max_drawdown;
+    double value_at_risk; // loss of one tick not exceeded with 'confidence', as a fraction
+};
+
+/*
+ * Risk measures for every ticker and the portfolio of the player: rolling
+ * volatility of the returns, current and maximum drawdown and the
+ * historical value at risk, all updated from the tick stream.
+
+   A series is a ticker, the last one (portfolioSeries()) is the equity of
+   the player. Every series costs O(1) per tick and has fixed-size state:
+   the volatility is a Welford mean and variance over a ring buffer of the
+   last 'period' log returns, where the oldest return is taken out as the
+   new one comes in. The VaR is the loss at the 1 - confidence quantile of
+   all returns since the series started, estimated by the P-square
+   algorithm with five markers instead of keeping the returns. Like in
+   IndicatorBank, the state is one array per quantity indexed by series.
+
+   update() publishes the measures under a sequence lock, so value() and
+   snapshot() never block and can be called from any thread.
+*/
+class RiskBank
+{
+public:
+    enum Measure { Volatility, Drawdown, MaxDrawdown, ValueAtRisk };
+
+    explicit RiskBank(int tickers = 1, int period = 100, double confidence = 0.95);
+    ~RiskBank();
+
+    void resize(int tickers); // only while nobody reads
+    void reset(int series);
+    void scale(int series, double factor); // e.g. 0.5 after a split
+
+    void update(const double *prices, double equity); // one price per ticker
+
+    double value(Measure, int series) const;
+    RiskSnapshot snapshot(int series) const;
+
+    int portfolioSeries(void) const;
+    double getConfidence(void) const;
+
+private:
+    void clear(int series);
+    void addReturn(int series, double r);
+    void addQuantileSample(int series, double r);
+    double quantile(int series) const;
+    void publish(int series);
+
+    int series_count, period;
+    double confidence;
+
+    // The ring buffer is period rows of 'series_count' returns, head is the row written next.
+    QVector<double> window;
+    int head;
+
+    QVector<int> count; // returns seen, 0 until the series has a first value
+    QVector<double> last, peak, drawdown, max_drawdown;
+    QVector<double> mean, m2;
+
+    // P-square markers, five per series: heights and (actual, desired) positions
+    QVector<double> heights, positions, desired;
+    double increments[5];
+
+    std::atomic<double> *published; // 4 per series
+    std::atomic<quint32> sequence;
+};
+
+#endif // RISKBANK_H
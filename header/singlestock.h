@@ -12,8 +12,10 @@ class SingleStock;
 
 /*
  * This is the UI class consisting the Buy/Sell buttons, the price LCDs,
- * the price diagram and the buy step spin box.
- * The company behind the graph is placed in the plot widget (ui->plot)
+ * the price diagram, the buy step spin box, the trigger row and the
+ * margin row.
+ * The company behind the graph lives in the market, the panel only shows
+ * the ticker it is bound to and can be rebound to another one at any time.
  */
 class SingleStock : public QWidget
 {
@@ -23,22 +25,34 @@ public:
     explicit SingleStock(QWidget *parent = 0);
     ~SingleStock();
 
+    void bindTicker(int ticker);
+    void unbind(void);
+    int getTicker(void);
+
 public slots:
     void buyStock(void);
     void sellStock(void);
+    void setTrigger(void);
+    void clearTriggers(void);
+    void openLong(void);
+    void openShort(void);
+    void closePositions(void);
 
 private slots:
     void changeBuyStep(int);
-    void bankrupt(void);
-    void reInit(void);
-    void split(void); // Only updates LCDs
+    void bankrupt(int);
+    void relisted(int);
+    void split(int);
+    void depotChanged(int);
+    void basketFilled(int);
+    void marginCall(int);
     void clearPriceBG(void);
-    void setCompanyName(void);
 
 private:
     Ui::SingleStock *ui;
 
     int buy_step;
+    int ticker;
 
 };
 
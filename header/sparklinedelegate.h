@@ -0,0 +1,65 @@
+#ifndef SPARKLINEDELEGATE_H
+#define SPARKLINEDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QHash>
+#include <QImage>
+#include <QPointF>
+#include <QVector>
+
+const int max_cached_sparklines = 1024;
+
+/*
+ * Draws the recent prices of a ticker as a small line chart into a table
+ * cell. The ticker is taken from Qt::UserRole of the index.
+
+   The prices are read straight from the market history, without any
+   QCustomPlot involved. Every sparkline is rendered into a QImage that is
+   kept until the market ticks again, so a repaint of the view only blits
+   the cached images. The history is decimated to the minimum and maximum
+   of buckets of ticks, at most one bucket per pixel column. The buckets
+   of a row are kept with its image and a tick only feeds its new prices
+   into the newest bucket and trims the oldest one, so a tick costs
+   O(pixel width) however long the history is. Splits and relistings
+   change the whole row and drop the cached sparkline of the ticker.
+*/
+class SparklineDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit SparklineDelegate(QObject *parent = 0);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+public slots:
+    void clearCache(void);
+    void dropSparkline(int ticker);
+
+private:
+    // The prices of the ticks [first_tick, first_tick + bucket_size) that
+    // are still in the history
+    struct Bucket
+    {
+        double min, max;
+        int min_tick, max_tick;
+    };
+
+    struct Sparkline
+    {
+        QImage image;
+        int tick; // the tick count the buckets and the image are at, -1 for none
+        int size; // history size at that tick
+        int bucket_size;
+        int first, last; // bucket numbers, bucket b holds the ticks from b * bucket_size
+        QVector<Bucket> buckets; // a ring indexed by the bucket number
+    };
+
+    void decimate(Sparkline &sparkline, int ticker) const;
+    void render(Sparkline &sparkline, int ticker) const;
+
+    mutable QHash<int,Sparkline> cache;
+    mutable QVector<QPointF> points;
+};
+
+#endif // SPARKLINEDELEGATE_H
@@ -0,0 +1,38 @@
+#ifndef STOCKGRID_H
+#define STOCKGRID_H
+
+#include <QAbstractScrollArea>
+#include <QList>
+
+#include <singlestock.h>
+
+const int panel_min_width = 420;
+const int panel_min_height = 300;
+
+/*
+ * A scrollable grid showing all tickers of the market.
+
+   Only the cells inside the viewport exist as SingleStock panels. The
+   panels are pooled and bound to whichever ticker scrolls into their cell,
+   so the number of live plots only depends on the window size and not on
+   the size of the market.
+*/
+class StockGrid : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    explicit StockGrid(QWidget *parent = 0);
+
+public slots:
+    void relayout(void);
+    void rebind(void);
+
+protected:
+    void resizeEvent(QResizeEvent *);
+    void scrollContentsBy(int dx, int dy);
+
+private:
+    QList<SingleStock*> panels;
+};
+
+#endif // STOCKGRID_H
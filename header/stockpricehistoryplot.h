@@ -5,13 +5,18 @@
 #include <QVector>
 #include <qcustomplot.h>
 #include <company.h>
+#include <indicatorbank.h>
+#include <market.h>
+
+const int ticks_per_candle = 10;
 
 /*
  * This class is the price diagram in a SingleStock widget.
- * It also owns the company depot.
+ * It shows one ticker of the market.
 
-   The current price is fetched from a price generator, e.g. LocalPriceGen
-   but maybe also some multi-player network price generator.
+   The prices are simulated by the market, the plot only reads the price
+   history of its ticker. It is bound to another ticker whenever the
+   panel is scrolled out of view.
 */
 class StockPriceHistoryPlot : public QCustomPlot
 {
@@ -19,25 +24,55 @@ class StockPriceHistoryPlot : public QCustomPlot
 public:
     explicit StockPriceHistoryPlot(QWidget *parent = 0);
 
-    void initCompanyPlot(int xmax = 1000, double ymax = 100);
+    void bindTicker(int ticker);
+    int getTicker(void);
 
 signals:
     void priceChanged(int);
-    void bankrupt(void);
-    void splitted(void);
 
 public slots:
     void setData();
+    void render(void);
+    void setCandleChart(bool);
+    void setIndicators(bool);
+
+protected:
+    void mouseMoveEvent(QMouseEvent *);
+    void leaveEvent(QEvent *);
+    void showEvent(QShowEvent *);
+    void paintEvent(QPaintEvent *);
+
+private slots:
+    void replotStarted(void);
+    void replotFinished(void);
 
 private:
+    void catchUp(void);
     void initPlot(void);
+    void initCrosshair(void);
+    void updateCrosshair(void);
+    void appendIndicators(int position, const IndicatorBank &bank, int bank_ticker);
+
+    int ticker;
+    bool stale; // ticks were skipped while hidden
+    bool dirty; // ticks arrived since the last frame
+
+    MetricHistogram *replot_time, *paint_latency;
+    qint64 replot_begin, frame_tick_time;
+
+    QCPFinancial *candles;
+    bool candle_chart, show_indicators;
 
-    Company company;
+    QCPItemStraightLine *cursor_line; // the position of the next tick
 
-    QVector<double> y,x,avg,update_limit,update_limitx,avgx;
-    int i, xmax, ymax;
+    // Hover crosshair, drawn on its own buffered layer
+    QCPLayer *overlay;
+    QCPItemStraightLine *cross_v, *cross_h;
+    QCPItemText *readout;
+    int hover_index;
 
-    friend class SingleStock;
+    QVector<double> y,x;
+    int xmax, ymax;
 };
 
 #endif // STOCKPRICEHISTORYPLOT_H
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Trace spans around the stages of the tick and render pipeline, to find
+ * out which stage blew the frame budget when the charts stutter.
+
+   Only compiled in with "qmake CONFIG+=trace", otherwise TRACE_SPAN
+   expands to nothing. A span is recorded when it goes out of scope, into
+   a ring buffer of the last trace_buffer_size spans of the current thread,
+   without any locking. Trace::dump() writes all buffers in the Chrome
+   trace event format, for chrome://tracing or ui.perfetto.dev.
+*/
+
+#ifdef STOCKTRADER_TRACE
+
+#include <QString>
+#include <QtGlobal>
+
+const int trace_buffer_size = 1 << 16;
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name); // name must stay valid, e.g. a literal
+    ~TraceSpan();
+
+private:
+    const char *name;
+    qint64 begin;
+};
+
+class Trace
+{
+public:
+    static const char *intern(const QString &name); // for names built at runtime, locks, so once per name
+    static bool dump(const QString &file_name);
+};
+
+#define TRACE_CONCAT_(a,b) a##b
+#define TRACE_CONCAT(a,b) TRACE_CONCAT_(a,b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_,__LINE__)(name)
+
+#else
+
+#define TRACE_SPAN(name)
+
+#endif // STOCKTRADER_TRACE
+
+#endif // TRACE_H
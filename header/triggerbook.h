@@ -0,0 +1,153 @@
+#ifndef TRIGGERBOOK_H
+#define TRIGGERBOOK_H
+
+#include <QVector>
+#include <QtGlobal>
+
+const int trigger_pool_size = 1 << 16; // open triggers of all tickers together
+const int trigger_index_bits = 20;     // low bits of a trigger id, the pool index
+
+struct Trigger
+{
+    enum Kind { StopLoss, TakeProfit, TrailingStop };
+
+    qint64 id; // 0 while the slot is free
+    int account, ticker;
+    Kind kind;
+    int quantity;
+    int price; // in price ticks, for trailing stops the distance below the peak
+
+    // Trailing stops only: the group and the ring of its members. 'next'
+    // links the free list too.
+    int group, prev, next;
+
+    int ticker_prev, ticker_next; // the ring of all triggers of the ticker
+};
+
+// A trigger that fired and has to be turned into a sell order
+struct TriggerEvent
+{
+    qint64 trigger;
+    int account, ticker;
+    Trigger::Kind kind;
+    int quantity;
+    int price; // the price that crossed it, in price ticks
+};
+
+/*
+ * Pairing max-heaps over the slots of a pool, all heaps of the pool share
+ * the nodes. A heap is just the index of its root, -1 if it is empty.
+ * Melding two heaps is O(1), popping and removing any node O(log n)
+ * amortized, and none of it allocates. Min-heaps use negated keys.
+ */
+class PairingHeaps
+{
+public:
+    explicit PairingHeaps(int size = 0);
+
+    qint64 key(int node) const;
+    void setKey(int node, qint64 key); // must keep the order of its heap
+
+    // Return the new root
+    int push(int root, int node, qint64 key);
+    int meld(int a, int b);
+    int remove(int root, int node);
+
+private:
+    struct Node
+    {
+        qint64 key;
+        int child, sibling;
+        int prev; // left sibling, or the parent of a first child
+    };
+
+    int link(int a, int b);
+    int mergePairs(int first);
+
+    QVector<Node> nodes;
+};
+
+/*
+ * Stop-loss, take-profit and trailing-stop triggers on the holdings of all
+ * tickers, evaluated in bulk once per market tick.
+
+   Only the triggers that the price crossed are touched. The stop-losses
+   of a ticker are a max-heap and the take-profits a min-heap by trigger
+   price, so a tick compares the price with the two roots.
+
+   A trailing stop fires once the price falls its distance below the
+   highest price since it was placed. All trailing stops whose peak the
+   price has risen past share the new peak, so they are kept in groups of
+   equal peak, each a min-heap by distance that fires at the peak minus
+   its smallest distance. The groups of a ticker form a stack sorted by
+   peak, lowest on top: a rising price melds the top groups into one, and
+   a max-heap of the groups by firing price finds the crossed ones.
+
+   The triggers of a ticker are linked in a ring as well, so corporate
+   actions and cancelling them all walk only the triggers of that ticker.
+*/
+class TriggerBook
+{
+public:
+    explicit TriggerBook(int tickers = 0);
+
+    void resize(int tickers); // drops all triggers
+
+    // Returns the id of the trigger or 0 if it was rejected, e.g. a full
+    // pool. Prices are in price ticks, the current one is the first peak
+    // of a trailing stop.
+    qint64 place(int account, int ticker, Trigger::Kind kind, int quantity, int price, int current_price);
+    bool cancel(qint64 id);
+    void cancelAll(int ticker, int account = -1); // of all accounts by default
+    void split(int ticker, int ratio = 2); // divides the prices and multiplies the quantities
+    void consolidate(int ticker, int ratio); // the other way round, drops triggers left without a share
+
+    void evaluate(const double *prices); // one simulated price per ticker
+
+    // Fired triggers since the last clearEvents()
+    int eventCount(void) const;
+    const TriggerEvent &event(int k) const;
+    void clearEvents(void);
+
+private:
+    struct TrailingGroup
+    {
+        int ticker, peak;
+        int size, members;  // ring of the triggers
+        int distances;      // heap root
+        int higher, lower;  // neighbours on the stack, 'higher' links the free list too
+    };
+
+    int find(qint64 id) const;
+    void raisePeaks(int ticker, int price);
+    void rescale(int ticker, int num, int den);
+    void fire(int trigger, int price);
+    void remove(int trigger);
+    void unlinkTrigger(int trigger);
+    int absorb(int group, int other);
+    void pushGroup(int ticker, int group);
+    void unlinkGroup(int group);
+    void attachGroup(int group);
+    void detachGroup(int group);
+
+    int tickers;
+    qint64 sequence;
+
+    QVector<Trigger> triggers;
+    int free_triggers;
+    PairingHeaps trigger_heaps;
+
+    QVector<TrailingGroup> groups; // a group has a trigger at least, so they can't run out
+    int free_groups;
+    PairingHeaps group_heaps;
+
+    // Heap roots and the top of the group stack per ticker
+    QVector<int> stop_losses, take_profits, trailing, group_tops;
+
+    QVector<int> ticker_triggers; // a trigger of every ticker, -1 if it has none
+
+    QVector<TriggerEvent> events; // a trigger fires once, so the pool size is enough
+    int event_count;
+};
+
+#endif // TRIGGERBOOK_H
@@ -26,6 +26,19 @@
 
 #include <qcustomplot.h>
 
+// Optional instrumentation of the replot stages, only with the application's trace build
+#ifdef STOCKTRADER_TRACE
+#  include <trace.h>
+#else
+#  define TRACE_SPAN(name)
+#endif
+
+// Optional attribution of heap allocations to the replot stages, only with the application's alloccount build
+#ifdef STOCKTRADER_ALLOC_COUNT
+#  include <allocationcounter.h>
+#else
+#  define ALLOCATION_PHASE(phase)
+#endif
 
 
 
@@ -721,6 +734,16 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   
   When a layer is deleted, the objects on it are not deleted with it, but fall on the layer below
   the deleted layer, see QCustomPlot::removeLayer.
+  
+  \section buffered Buffered layers
+  
+  By default, all layers are drawn into one paint buffer of the QCustomPlot, so any change requires
+  a complete \ref QCustomPlot::replot. Layers whose contents change much more often than the rest
+  of the plot (e.g. a crosshair following the mouse cursor) can be given their own paint buffer
+  with \ref setMode(lmBuffered). Such a layer can then be redrawn on its own with \ref replot,
+  which only repaints its own objects and composites them over the cached rest of the plot.
+  Buffered layers are always composited on top of the main paint buffer (in the order of their
+  layer indices), so they are meant for the topmost layers of a plot.
 */
 
 /* start documentation of inline functions */
@@ -753,10 +776,15 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   QObject(parentPlot),
   mParentPlot(parentPlot),
   mName(layerName),
-  mIndex(-1) // will be set to a proper value by the QCustomPlot layer creation function
+  mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
+  mMode(lmLogical),
+  mTraceName(0)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
+#ifdef STOCKTRADER_TRACE
+  mTraceName = Trace::intern(QLatin1String("QCPLayer::draw ") + mName);
+#endif
 }
 
 QCPLayer::~QCPLayer()
@@ -810,6 +838,91 @@ void QCPLayer::removeChild(QCPLayerable *layerable)
     qDebug() << Q_FUNC_INFO << "layerable is not child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
 
+/*!
+  Sets how this layer is rendered by the parent plot. If \a mode is \ref lmBuffered, the layer
+  gets its own paint buffer and can be replotted individually with \ref replot.
+  
+  The new mode takes effect with the next \ref QCustomPlot::replot.
+  
+  \see LayerMode
+*/
+void QCPLayer::setMode(QCPLayer::LayerMode mode)
+{
+  if (mMode != mode)
+  {
+    mMode = mode;
+    if (mMode == lmLogical)
+      mPaintBuffer = QPixmap();
+  }
+}
+
+/*!
+  If this layer is in \ref lmBuffered mode, only the objects on this layer are drawn into the
+  layer's own paint buffer, which is then composited over the cached rest of the plot. This is
+  much cheaper than a complete \ref QCustomPlot::replot and is meant for frequently changing
+  overlays like crosshairs or cursors.
+  
+  The layer objects are drawn with the axis ranges and layout of the last complete replot of the
+  parent plot.
+  
+  If this layer is in \ref lmLogical mode, a complete \ref QCustomPlot::replot is performed.
+  
+  \see setMode
+*/
+void QCPLayer::replot()
+{
+  TRACE_SPAN("QCPLayer::replot");
+  if (mMode == lmBuffered && !mParentPlot->mPaintBuffer.isNull())
+  {
+    drawToPaintBuffer();
+    mParentPlot->update();
+  } else
+    mParentPlot->replot();
+}
+
+/*! \internal
+  
+  Draws all visible layerables on this layer with the provided \a painter, in the order of the
+  children list.
+*/
+void QCPLayer::draw(QCPPainter *painter)
+{
+  TRACE_SPAN(mTraceName);
+  for (int i=0; i < mChildren.size(); ++i)
+  {
+    QCPLayerable *child = mChildren.at(i);
+    if (child->realVisibility())
+    {
+      painter->save();
+      painter->setClipRect(child->clipRect().translated(0, -1));
+      child->applyDefaultAntialiasingHint(painter);
+      child->draw(painter);
+      painter->restore();
+    }
+  }
+}
+
+/*! \internal
+  
+  Clears the paint buffer of a buffered layer to transparent and draws the layer's objects into
+  it. The buffer is resized to the main paint buffer of the parent plot if necessary.
+*/
+void QCPLayer::drawToPaintBuffer()
+{
+  if (mPaintBuffer.size() != mParentPlot->mPaintBuffer.size())
+    mPaintBuffer = QPixmap(mParentPlot->mPaintBuffer.size());
+  mPaintBuffer.fill(Qt::transparent);
+  QCPPainter painter;
+  painter.begin(&mPaintBuffer);
+  if (painter.isActive())
+  {
+    painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
+    draw(&painter);
+    painter.end();
+  } else // might happen if QCustomPlot has width or height zero
+    qDebug() << Q_FUNC_INFO << "Couldn't activate painter on layer buffer";
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPLayerable
@@ -8673,7 +8786,8 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mMultiSelectModifier(Qt::ControlModifier),
   mPaintBuffer(size()),
   mMouseEventElement(0),
-  mReplotting(false)
+  mReplotting(false),
+  mReplotQueued(false)
 {
   setAttribute(Qt::WA_NoMousePropagation);
   setAttribute(Qt::WA_OpaquePaintEvent);
@@ -9998,6 +10112,12 @@ void QCustomPlot::deselectAll()
   buffer on the QCustomPlot widget surface. This is the method that must be called to make changes,
   for example on the axis ranges or data points of graphs, visible.
   
+  \a refreshPriority controls how the widget surface is refreshed after the buffer was replotted,
+  see \ref RefreshPriority. If it is \ref rpQueuedReplot, the replot itself is deferred: the plot
+  is only marked as outdated and replotted once control returns to the event loop. Any further
+  queued replots until then, e.g. from several signals that fire during one tick, cause no
+  additional replot. An immediate replot in between also satisfies the queued one.
+  
   Under a few circumstances, QCustomPlot causes a replot by itself. Those are resize events of the
   QCustomPlot widget and user interactions (object selection and range dragging/zooming).
   
@@ -10006,11 +10126,24 @@ void QCustomPlot::deselectAll()
   signals on two QCustomPlots to make them replot synchronously, it won't cause an infinite
   recursion.
 */
-void QCustomPlot::replot()
+void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
+  ALLOCATION_PHASE(phase_replot);
+  if (refreshPriority == rpQueuedReplot)
+  {
+    if (!mReplotQueued)
+    {
+      mReplotQueued = true;
+      QTimer::singleShot(0, this, SLOT(processQueuedReplot()));
+    }
+    return;
+  }
+  
   if (mReplotting) // incase signals loop back to replot slot
     return;
+  TRACE_SPAN("QCustomPlot::replot");
   mReplotting = true;
+  mReplotQueued = false;
   emit beforeReplot();
   mPaintBuffer.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color() : Qt::transparent);
   QCPPainter painter;
@@ -10022,7 +10155,12 @@ void QCustomPlot::replot()
       painter.fillRect(mViewport, mBackgroundBrush);
     draw(&painter);
     painter.end();
-    if (mPlottingHints.testFlag(QCP::phForceRepaint))
+    for (int i=0; i<mLayers.size(); ++i)
+    {
+      if (mLayers.at(i)->mode() == QCPLayer::lmBuffered)
+        mLayers.at(i)->drawToPaintBuffer();
+    }
+    if (refreshPriority == rpImmediateRefresh || (refreshPriority == rpRefreshHint && mPlottingHints.testFlag(QCP::phForceRepaint)))
       repaint();
     else
       update();
@@ -10278,13 +10416,21 @@ QSize QCustomPlot::sizeHint() const
 /*! \internal
   
   Event handler for when the QCustomPlot widget needs repainting. This does not cause a \ref replot, but
-  draws the internal buffer on the widget surface.
+  draws the internal buffer on the widget surface, followed by the buffers of all buffered layers.
 */
 void QCustomPlot::paintEvent(QPaintEvent *event)
 {
   Q_UNUSED(event);
+  TRACE_SPAN("QCustomPlot::paintEvent");
+  ALLOCATION_PHASE(phase_paint);
   QPainter painter(this);
   painter.drawPixmap(0, 0, mPaintBuffer);
+  // composite buffered layers (see QCPLayer::setMode) over the main buffer:
+  for (int i=0; i<mLayers.size(); ++i)
+  {
+    if (mLayers.at(i)->mode() == QCPLayer::lmBuffered)
+      painter.drawPixmap(0, 0, mLayers.at(i)->mPaintBuffer);
+  }
 }
 
 /*! \internal
@@ -10516,19 +10662,10 @@ void QCustomPlot::draw(QCPPainter *painter)
   // draw all layered objects (grid, axes, plottables, items, legend,...):
   for (int layerIndex=0; layerIndex < mLayers.size(); ++layerIndex)
   {
-    QList<QCPLayerable*> layerChildren = mLayers.at(layerIndex)->children();
-    for (int k=0; k < layerChildren.size(); ++k)
-    {
-      QCPLayerable *child = layerChildren.at(k);
-      if (child->realVisibility())
-      {
-        painter->save();
-        painter->setClipRect(child->clipRect().translated(0, -1));
-        child->applyDefaultAntialiasingHint(painter);
-        child->draw(painter);
-        painter->restore();
-      }
-    }
+    // buffered layers are drawn into their own buffers by replot, but are included in exports:
+    if (painter->device() == &mPaintBuffer && mLayers.at(layerIndex)->mode() == QCPLayer::lmBuffered)
+      continue;
+    mLayers.at(layerIndex)->draw(painter);
   }
 }
 
@@ -10571,6 +10708,19 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   }
 }
 
+/*! \internal
+  
+  Performs a replot that was requested with \ref rpQueuedReplot, unless an immediate replot has
+  happened since the request.
+  
+  \see replot
+*/
+void QCustomPlot::processQueuedReplot()
+{
+  if (mReplotQueued)
+    replot(rpRefreshHint);
+}
+
 
 /*! \internal
   
@@ -10724,6 +10874,62 @@ QPixmap QCustomPlot::toPixmap(int width, int height, double scale)
   return result;
 }
 
+/*!
+  Renders the plot to an image and returns it.
+  
+  The plot is sized to \a width and \a height in pixels and scaled with \a scale. (width 100 and
+  scale 2.0 lead to a full resolution image with width 200.)
+  
+  Unlike \ref toPixmap, the result doesn't depend on the screen and is a QImage, which can be
+  handed to other threads, e.g. to encode and save many plots concurrently for export. Like every
+  other method of QCustomPlot, which is a QWidget, this one must be called in the GUI thread.
+  
+  \see toPixmap, toPainter
+*/
+QImage QCustomPlot::toImage(int width, int height, double scale)
+{
+  // this method is somewhat similar to toPixmap. Change something here, and a change in toPixmap might be necessary, too. 
+  int newWidth, newHeight;
+  if (width == 0 || height == 0)
+  {
+    newWidth = this->width();
+    newHeight = this->height();
+  } else
+  {
+    newWidth = width;
+    newHeight = height;
+  }
+  int scaledWidth = qRound(scale*newWidth);
+  int scaledHeight = qRound(scale*newHeight);
+  
+  QImage result(scaledWidth, scaledHeight, QImage::Format_ARGB32_Premultiplied);
+  result.fill(mBackgroundBrush.style() == Qt::SolidPattern ? mBackgroundBrush.color().rgba() : qRgba(0, 0, 0, 0)); // if using non-solid pattern, make transparent now and draw brush pattern later
+  QCPPainter painter;
+  painter.begin(&result);
+  if (painter.isActive())
+  {
+    QRect oldViewport = viewport();
+    setViewport(QRect(0, 0, newWidth, newHeight));
+    painter.setMode(QCPPainter::pmNoCaching); // label caching uses pixmaps
+    if (!qFuzzyCompare(scale, 1.0))
+    {
+      if (scale > 1.0) // for scale < 1 we always want cosmetic pens where possible, because else lines might disappear for very small scales
+        painter.setMode(QCPPainter::pmNonCosmetic);
+      painter.scale(scale, scale);
+    }
+    if (mBackgroundBrush.style() != Qt::SolidPattern && mBackgroundBrush.style() != Qt::NoBrush)
+      painter.fillRect(mViewport, mBackgroundBrush);
+    draw(&painter);
+    setViewport(oldViewport);
+    painter.end();
+  } else // might happen if image has width or height zero
+  {
+    qDebug() << Q_FUNC_INFO << "Couldn't activate painter on image";
+    return QImage();
+  }
+  return result;
+}
+
 /*!
   Renders the plot using the passed \a painter.
   
@@ -10861,7 +11067,13 @@ QCPData::QCPData(double key, double value) :
   To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
 */
 QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable(keyAxis, valueAxis)
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  mSegmentIndexValid(false),
+  mSegmentPairwise(false),
+  mSegmentGridColumns(0),
+  mSegmentGridRows(0),
+  mSegmentCellSize(16),
+  mSegmentLineStyle(lsNone)
 {
   mData = new QCPDataMap;
   
@@ -10892,6 +11104,7 @@ QCPGraph::~QCPGraph()
 */
 void QCPGraph::setData(QCPDataMap *data, bool copy)
 {
+  mSegmentIndexValid = false;
   if (copy)
   {
     *mData = *data;
@@ -10910,6 +11123,7 @@ void QCPGraph::setData(QCPDataMap *data, bool copy)
 */
 void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -10933,6 +11147,7 @@ void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
 */
 void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -10959,6 +11174,7 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -10986,6 +11202,7 @@ void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<doubl
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -11012,6 +11229,7 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -11039,6 +11257,7 @@ void QCPGraph::setDataKeyError(const QVector<double> &key, const QVector<double>
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyError, const QVector<double> &valueError)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -11068,6 +11287,7 @@ void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double
 */
 void QCPGraph::setDataBothError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &keyErrorMinus, const QVector<double> &keyErrorPlus, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
 {
+  mSegmentIndexValid = false;
   mData->clear();
   int n = key.size();
   n = qMin(n, value.size());
@@ -11192,6 +11412,7 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
 */
 void QCPGraph::addData(const QCPDataMap &dataMap)
 {
+  mSegmentIndexValid = false;
   mData->unite(dataMap);
 }
 
@@ -11201,6 +11422,7 @@ void QCPGraph::addData(const QCPDataMap &dataMap)
 */
 void QCPGraph::addData(const QCPData &data)
 {
+  mSegmentIndexValid = false;
   mData->insertMulti(data.key, data);
 }
 
@@ -11210,6 +11432,7 @@ void QCPGraph::addData(const QCPData &data)
 */
 void QCPGraph::addData(double key, double value)
 {
+  mSegmentIndexValid = false;
   QCPData newData;
   newData.key = key;
   newData.value = value;
@@ -11222,6 +11445,7 @@ void QCPGraph::addData(double key, double value)
 */
 void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &values)
 {
+  mSegmentIndexValid = false;
   int n = qMin(keys.size(), values.size());
   QCPData newData;
   for (int i=0; i<n; ++i)
@@ -11232,12 +11456,32 @@ void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &value
   }
 }
 
+/*!
+  Sets the value of the existing data point at \a key to \a value and returns true. If the graph
+  has no data point at \a key, nothing is changed and false is returned.
+  
+  In contrast to \ref addData, this never allocates memory. It's the cheapest way to update graphs
+  whose keys stay the same while their values change, e.g. a ring buffer over a fixed key range.
+  
+  \see addData, removeData
+*/
+bool QCPGraph::setDataValue(double key, double value)
+{
+  QCPDataMap::iterator it = mData->find(key);
+  if (it == mData->end())
+    return false;
+  it.value().value = value;
+  mSegmentIndexValid = false;
+  return true;
+}
+
 /*!
   Removes all data points with keys smaller than \a key.
   \see addData, clearData
 */
 void QCPGraph::removeDataBefore(double key)
 {
+  mSegmentIndexValid = false;
   QCPDataMap::iterator it = mData->begin();
   while (it != mData->end() && it.key() < key)
     it = mData->erase(it);
@@ -11249,6 +11493,7 @@ void QCPGraph::removeDataBefore(double key)
 */
 void QCPGraph::removeDataAfter(double key)
 {
+  mSegmentIndexValid = false;
   if (mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(key);
   while (it != mData->end())
@@ -11264,6 +11509,7 @@ void QCPGraph::removeDataAfter(double key)
 */
 void QCPGraph::removeData(double fromKey, double toKey)
 {
+  mSegmentIndexValid = false;
   if (fromKey >= toKey || mData->isEmpty()) return;
   QCPDataMap::iterator it = mData->upperBound(fromKey);
   QCPDataMap::iterator itEnd = mData->upperBound(toKey);
@@ -11281,6 +11527,7 @@ void QCPGraph::removeData(double fromKey, double toKey)
 */
 void QCPGraph::removeData(double key)
 {
+  mSegmentIndexValid = false;
   mData->remove(key);
 }
 
@@ -11290,6 +11537,7 @@ void QCPGraph::removeData(double key)
 */
 void QCPGraph::clearData()
 {
+  mSegmentIndexValid = false;
   mData->clear();
 }
 
@@ -11395,11 +11643,15 @@ void QCPGraph::draw(QCPPainter *painter)
   if (mKeyAxis.data()->range().size() <= 0 || mData->isEmpty()) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
-  // allocate line and (if necessary) point vectors:
-  QVector<QPointF> *lineData = new QVector<QPointF>;
+  // reuse line and (if necessary) point vectors of the last draw, they keep their capacity:
+  QVector<QPointF> *lineData = &mLineBuffer;
   QVector<QCPData> *pointData = 0;
+  lineData->resize(0);
   if (!mScatterStyle.isNone())
-    pointData = new QVector<QCPData>;
+  {
+    pointData = &mPointBuffer;
+    pointData->resize(0);
+  }
   
   // fill vectors with data appropriate to plot style:
   getPlotData(lineData, pointData);
@@ -11428,11 +11680,6 @@ void QCPGraph::draw(QCPPainter *painter)
   // draw scatters:
   if (pointData)
     drawScatterPlot(painter, pointData);
-  
-  // free allocated line and point vectors:
-  delete lineData;
-  if (pointData)
-    delete pointData;
 }
 
 /* inherits documentation from base class */
@@ -11969,7 +12216,7 @@ void QCPGraph::drawFill(QCPPainter *painter, QVector<QPointF> *lineData) const
     addFillBasePoints(lineData);
     painter->setPen(Qt::NoPen);
     painter->setBrush(mainBrush());
-    painter->drawPolygon(QPolygonF(*lineData));
+    painter->drawPolygon(lineData->constData(), lineData->size());
     removeFillBasePoints(lineData);
   } else
   {
@@ -12032,6 +12279,9 @@ void QCPGraph::drawScatterPlot(QCPPainter *painter, QVector<QCPData> *pointData)
   connections between the point vector they create. These are for example \ref getLinePlotData,
   \ref getStepLeftPlotData, \ref getStepRightPlotData and \ref getStepCenterPlotData.
   
+  Points with a NaN coordinate, i.e. data points with a NaN value, are left out and interrupt the
+  line, so a graph with fixed keys can leave gaps without removing data points.
+  
   \see drawScatterPlot, drawImpulsePlot
 */
 void QCPGraph::drawLinePlot(QCPPainter *painter, QVector<QPointF> *lineData) const
@@ -12059,16 +12309,28 @@ void QCPGraph::drawLinePlot(QCPPainter *painter, QVector<QPointF> *lineData) con
     */
     
     // if drawing solid line and not in PDF, use much faster line drawing instead of polyline:
-    if (mParentPlot->plottingHints().testFlag(QCP::phFastPolylines) &&
+    const bool fastLines = mParentPlot->plottingHints().testFlag(QCP::phFastPolylines) &&
         painter->pen().style() == Qt::SolidLine &&
         !painter->modes().testFlag(QCPPainter::pmVectorized)&&
-        !painter->modes().testFlag(QCPPainter::pmNoCaching))
+        !painter->modes().testFlag(QCPPainter::pmNoCaching);
+    // draw each run of points between NaN points on its own:
+    int begin = 0;
+    while (begin < lineData->size())
     {
-      for (int i=1; i<lineData->size(); ++i)
-        painter->drawLine(lineData->at(i-1), lineData->at(i));
-    } else
-    {  
-      painter->drawPolyline(QPolygonF(*lineData));
+      while (begin < lineData->size() && (qIsNaN(lineData->at(begin).x()) || qIsNaN(lineData->at(begin).y())))
+        ++begin;
+      int end = begin;
+      while (end < lineData->size() && !qIsNaN(lineData->at(end).x()) && !qIsNaN(lineData->at(end).y()))
+        ++end;
+      if (fastLines)
+      {
+        for (int i=begin+1; i<end; ++i)
+          painter->drawLine(lineData->at(i-1), lineData->at(i));
+      } else if (end-begin > 1)
+      {
+        painter->drawPolyline(lineData->constData()+begin, end-begin);
+      }
+      begin = end;
     }
   }
 }
@@ -12635,6 +12897,12 @@ int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
   If either the graph has no data or if the line style is \ref lsNone and the scatter style's shape
   is \ref QCPScatterStyle::ssNone (i.e. there is no visual representation of the graph), returns
   500.
+  
+  The pixel representation of the graph is cached in a grid of cells (see \ref
+  updateSegmentIndex), which is only rebuilt when the data or the axes changed. The search starts
+  at the cell of \a pixelPoint and stops as soon as no unvisited cell can contain a closer
+  segment, so the cost depends on the number of segments near \a pixelPoint rather than the total
+  number of data points.
 */
 double QCPGraph::pointDistance(const QPointF &pixelPoint) const
 {
@@ -12651,54 +12919,177 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
   
   if (mLineStyle == lsNone && mScatterStyle.isNone())
     return 500;
+  if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return 500; }
   
-  // calculate minimum distances to graph representation:
-  if (mLineStyle == lsNone)
+  updateSegmentIndex();
+  if (mSegmentPoints.size() < 2)
+    return 500;
+  
+  // search the grid cells in growing square rings around the cell of pixelPoint:
+  const double left = mSegmentGridRect.left();
+  const double top = mSegmentGridRect.top();
+  const int column = segmentGridCell(pixelPoint.x(), left, mSegmentGridColumns);
+  const int row = segmentGridCell(pixelPoint.y(), top, mSegmentGridRows);
+  double minDistSqr = std::numeric_limits<double>::max();
+  for (int ring=0; ; ++ring)
   {
-    // no line displayed, only calculate distance to scatter points:
-    QVector<QCPData> *pointData = new QVector<QCPData>;
-    getScatterPlotData(pointData);
-    double minDistSqr = std::numeric_limits<double>::max();
-    QPointF ptA;
-    QPointF ptB = coordsToPixels(pointData->at(0).key, pointData->at(0).value); // getScatterPlotData returns in plot coordinates, so transform to pixels
-    for (int i=1; i<pointData->size(); ++i)
+    int c0 = column-ring, c1 = column+ring;
+    int r0 = row-ring, r1 = row+ring;
+    for (int r=qMax(r0, 0); r<=qMin(r1, mSegmentGridRows-1); ++r)
     {
-      ptA = ptB;
-      ptB = coordsToPixels(pointData->at(i).key, pointData->at(i).value);
-      double currentDistSqr = distSqrToLine(ptA, ptB, pixelPoint);
-      if (currentDistSqr < minDistSqr)
-        minDistSqr = currentDistSqr;
+      // inside the ring, only the first and last column belong to it:
+      int step = (r == r0 || r == r1 || ring == 0) ? 1 : c1-c0;
+      for (int c=c0; c<=c1; c+=step)
+      {
+        if (c < 0 || c >= mSegmentGridColumns)
+          continue;
+        int cell = r*mSegmentGridColumns+c;
+        for (int k=mSegmentCellStart.at(cell); k<mSegmentCellStart.at(cell+1); ++k)
+        {
+          int i = mSegmentCellEntries.at(k);
+          double currentDistSqr = distSqrToLine(mSegmentPoints.at(i), mSegmentPoints.at(i+1), pixelPoint);
+          if (currentDistSqr < minDistSqr)
+            minDistSqr = currentDistSqr;
+        }
+      }
     }
-    delete pointData;
-    return sqrt(minDistSqr);
-  } else
+    // all segments not visited yet lie outside the block of cells visited so far, so their
+    // distance is at least the distance of pixelPoint to the block border:
+    double bound = std::numeric_limits<double>::max();
+    if (c0 > 0)
+      bound = qMin(bound, pixelPoint.x()-(left+c0*mSegmentCellSize));
+    if (c1 < mSegmentGridColumns-1)
+      bound = qMin(bound, left+(c1+1)*mSegmentCellSize-pixelPoint.x());
+    if (r0 > 0)
+      bound = qMin(bound, pixelPoint.y()-(top+r0*mSegmentCellSize));
+    if (r1 < mSegmentGridRows-1)
+      bound = qMin(bound, top+(r1+1)*mSegmentCellSize-pixelPoint.y());
+    if (bound == std::numeric_limits<double>::max() || minDistSqr <= bound*bound)
+      break;
+  }
+  return sqrt(minDistSqr);
+}
+
+/*! \internal
+  
+  Returns the column (or row) of the segment index grid that contains the pixel coordinate \a
+  pixel, for a grid starting at \a origin with \a cellCount cells. Coordinates outside the grid
+  map to its border cells. The cell is clamped while still a double, since the pixel coordinates
+  of points far off-screen (e.g. at a large zoom) don't fit into an int.
+*/
+int QCPGraph::segmentGridCell(double pixel, double origin, int cellCount) const
+{
+  const double cell = (pixel-origin)/mSegmentCellSize;
+  if (!(cell > 0)) // also catches NaN
+    return 0;
+  if (cell >= cellCount-1)
+    return cellCount-1;
+  return qFloor(cell);
+}
+
+/*! \internal
+  
+  Returns whether the pixel-space segment index built by \ref updateSegmentIndex still matches
+  the data, line style, axis ranges and axis geometry of this graph.
+*/
+bool QCPGraph::segmentIndexUpToDate() const
+{
+  if (!mSegmentIndexValid || mSegmentLineStyle != mLineStyle)
+    return false;
+  QCPRange keyRange = mKeyAxis.data()->range();
+  QCPRange valueRange = mValueAxis.data()->range();
+  if (mSegmentKeyRange != keyRange || mSegmentValueRange != valueRange)
+    return false;
+  // the pixel positions of these reference coordinates change with the axis rect geometry, range
+  // reversal and scale type:
+  return mSegmentReference[0] == coordsToPixels(keyRange.lower, valueRange.lower) &&
+         mSegmentReference[1] == coordsToPixels(keyRange.upper, valueRange.upper) &&
+         mSegmentReference[2] == coordsToPixels(keyRange.center(), valueRange.center());
+}
+
+/*! \internal
+  
+  Rebuilds the pixel-space segment index used by \ref pointDistance, if the data, line style or
+  axes changed since it was last built.
+  
+  The index holds the pixel coordinates of the graph representation (the line points, or the
+  scatter points for \ref lsNone) and a uniform grid of square cells over the axis rect. Every cell
+  stores the indices of the segments whose bounding box overlaps it, in one contiguous array
+  (offsets per cell in mSegmentCellStart). Segments outside the axis rect are put into the border
+  cells. Repeated hit tests on an unchanged graph then only look at the segments near the cursor
+  instead of regenerating and scanning the whole line.
+*/
+void QCPGraph::updateSegmentIndex() const
+{
+  if (segmentIndexUpToDate())
+    return;
+  
+  // get pixel coordinates of the graph representation:
+  mSegmentPoints.resize(0);
+  if (mLineStyle == lsNone)
   {
-    // line displayed calculate distance to line segments:
-    QVector<QPointF> *lineData = new QVector<QPointF>;
-    getPlotData(lineData, 0); // unlike with getScatterPlotData we get pixel coordinates here
-    double minDistSqr = std::numeric_limits<double>::max();
-    if (mLineStyle == lsImpulse)
+    QVector<QCPData> pointData;
+    getScatterPlotData(&pointData);
+    mSegmentPoints.resize(pointData.size());
+    for (int i=0; i<pointData.size(); ++i)
+      mSegmentPoints[i] = coordsToPixels(pointData.at(i).key, pointData.at(i).value);
+  } else
+    getPlotData(&mSegmentPoints, 0);
+  // impulse plot differs from other line styles in that the points are only pairwise connected:
+  mSegmentPairwise = mLineStyle == lsImpulse;
+  
+  // set up grid over axis rect:
+  mSegmentGridRect = mKeyAxis.data()->axisRect()->rect();
+  mSegmentGridColumns = qMax(1, mSegmentGridRect.width()/mSegmentCellSize+1);
+  mSegmentGridRows = qMax(1, mSegmentGridRect.height()/mSegmentCellSize+1);
+  int cellCount = mSegmentGridColumns*mSegmentGridRows;
+  int segmentStep = mSegmentPairwise ? 2 : 1;
+  
+  // first pass counts the entries per cell, second pass fills them in:
+  mSegmentCellStart.fill(0, cellCount+1);
+  for (int pass=0; pass<2; ++pass)
+  {
+    if (pass == 1)
     {
-      // impulse plot differs from other line styles in that the lineData points are only pairwise connected:
-      for (int i=0; i<lineData->size()-1; i+=2) // iterate pairs
-      {
-        double currentDistSqr = distSqrToLine(lineData->at(i), lineData->at(i+1), pixelPoint);
-        if (currentDistSqr < minDistSqr)
-          minDistSqr = currentDistSqr;
-      }
-    } else 
+      for (int cell=0; cell<cellCount; ++cell)
+        mSegmentCellStart[cell+1] += mSegmentCellStart[cell];
+      mSegmentCellEntries.resize(mSegmentCellStart.at(cellCount));
+    }
+    QVector<int> fillPosition;
+    if (pass == 1)
+      fillPosition = mSegmentCellStart;
+    for (int i=0; i+1<mSegmentPoints.size(); i+=segmentStep)
     {
-      // all other line plots (line and step) connect points directly:
-      for (int i=0; i<lineData->size()-1; ++i)
+      const QPointF &a = mSegmentPoints.at(i);
+      const QPointF &b = mSegmentPoints.at(i+1);
+      int c0 = segmentGridCell(qMin(a.x(), b.x()), mSegmentGridRect.left(), mSegmentGridColumns);
+      int c1 = segmentGridCell(qMax(a.x(), b.x()), mSegmentGridRect.left(), mSegmentGridColumns);
+      int r0 = segmentGridCell(qMin(a.y(), b.y()), mSegmentGridRect.top(), mSegmentGridRows);
+      int r1 = segmentGridCell(qMax(a.y(), b.y()), mSegmentGridRect.top(), mSegmentGridRows);
+      for (int r=r0; r<=r1; ++r)
       {
-        double currentDistSqr = distSqrToLine(lineData->at(i), lineData->at(i+1), pixelPoint);
-        if (currentDistSqr < minDistSqr)
-          minDistSqr = currentDistSqr;
+        for (int c=c0; c<=c1; ++c)
+        {
+          int cell = r*mSegmentGridColumns+c;
+          if (pass == 0)
+            ++mSegmentCellStart[cell+1];
+          else
+            mSegmentCellEntries[fillPosition[cell]++] = i;
+        }
       }
     }
-    delete lineData;
-    return sqrt(minDistSqr);
   }
+  
+  // remember state the index was built for:
+  QCPRange keyRange = mKeyAxis.data()->range();
+  QCPRange valueRange = mValueAxis.data()->range();
+  mSegmentKeyRange = keyRange;
+  mSegmentValueRange = valueRange;
+  mSegmentReference[0] = coordsToPixels(keyRange.lower, valueRange.lower);
+  mSegmentReference[1] = coordsToPixels(keyRange.upper, valueRange.upper);
+  mSegmentReference[2] = coordsToPixels(keyRange.center(), valueRange.center());
+  mSegmentLineStyle = mLineStyle;
+  mSegmentIndexValid = true;
 }
 
 /*! \internal
@@ -12866,6 +13257,11 @@ QCPRange QCPGraph::getValueRange(bool &validRange, SignDomain inSignDomain, bool
     while (it != mData->constEnd())
     {
       current = it.value().value;
+      if (qIsNaN(current)) // gaps in the line
+      {
+        ++it;
+        continue;
+      }
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
       currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
       if (current-currentErrorMinus < range.lower || !haveLower)
@@ -12886,6 +13282,11 @@ QCPRange QCPGraph::getValueRange(bool &validRange, SignDomain inSignDomain, bool
     while (it != mData->constEnd())
     {
       current = it.value().value;
+      if (qIsNaN(current)) // gaps in the line
+      {
+        ++it;
+        continue;
+      }
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
       currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
       if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus < 0)
@@ -12919,6 +13320,11 @@ QCPRange QCPGraph::getValueRange(bool &validRange, SignDomain inSignDomain, bool
     while (it != mData->constEnd())
     {
       current = it.value().value;
+      if (qIsNaN(current)) // gaps in the line
+      {
+        ++it;
+        continue;
+      }
       currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
       currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
       if ((current-currentErrorMinus < range.lower || !haveLower) && current-currentErrorMinus > 0)
@@ -14680,6 +15086,609 @@ QCPRange QCPStatisticalBox::getValueRange(bool &validRange, SignDomain inSignDom
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPFinancialData
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPFinancialData
+  \brief Holds the data of one single data point (one candle) for QCPFinancial.
+  
+  The container for storing multiple data points is \ref QCPFinancialDataVector.
+  
+  The stored data is:
+  \li \a key: coordinate on the key axis of this candle
+  \li \a open: the opening value of the interval
+  \li \a high: the highest value of the interval
+  \li \a low: the lowest value of the interval
+  \li \a close: the closing value of the interval
+  
+  \see QCPFinancialDataVector
+*/
+
+/*!
+  Constructs a financial data point with key and all values set to zero.
+*/
+QCPFinancialData::QCPFinancialData() :
+  key(0),
+  open(0),
+  high(0),
+  low(0),
+  close(0)
+{
+}
+
+/*!
+  Constructs a financial data point with the specified \a key and OHLC values.
+*/
+QCPFinancialData::QCPFinancialData(double key, double open, double high, double low, double close) :
+  key(key),
+  open(open),
+  high(high),
+  low(low),
+  close(close)
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPFinancial
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPFinancial
+  \brief A plottable representing a financial stock chart
+
+  This plottable represents time series data binned to certain intervals, mainly used for stock
+  charts. The two common representations OHLC (Open-High-Low-Close) bars and Candlesticks can be
+  set via \ref setChartStyle.
+  
+  The data is held in a contiguous \ref QCPFinancialDataVector sorted by key, so appending at the
+  end and mutating the most recent candle are cheap. For streaming data, use \ref addTick: it only
+  touches the candle at the passed key and starts a new one when the key changes.
+  
+  \section appearance Changing the appearance
+  
+  Charts can be either single- or two-colored (\ref setTwoColored). If set to be single-colored,
+  lines are drawn with the plottable's pen (\ref setPen) and fills with the brush (\ref setBrush).
+  If set to two-colored, positive changes of the value during an interval (\a close >= \a open)
+  are represented with a different pen and brush than negative changes (\a close < \a open). These
+  can be configured with \ref setPenPositive, \ref setPenNegative, \ref setBrushPositive, and
+  \ref setBrushNegative. In two-colored mode, the normal plottable pen/brush is ignored. Upon
+  selection however, the normal selected pen/brush (\ref setSelectedPen, \ref setSelectedBrush)
+  is used, irrespective of whether the chart is single- or two-colored.
+  
+  All candles of one color are collected first and then drawn with a single QPainter::drawRects
+  and QPainter::drawLines call, so the painting cost doesn't grow with the number of primitive
+  calls.
+  
+  \section usage Usage
+  
+  Like all data representing objects in QCustomPlot, the QCPFinancial is a plottable
+  (QCPAbstractPlottable). So the plottable-interface of QCustomPlot applies
+  (QCustomPlot::plottable, QCustomPlot::addPlottable, QCustomPlot::removePlottable, etc.)
+  
+  Usually, you first create an instance:
+  \code
+  QCPFinancial *newFinancial = new QCPFinancial(customPlot->xAxis, customPlot->yAxis);\endcode
+  add it to the customPlot with QCustomPlot::addPlottable:
+  \code
+  customPlot->addPlottable(newFinancial);\endcode
+  and then modify the properties of the newly created plottable, e.g.:
+  \code
+  newFinancial->setName("Stock prices");
+  newFinancial->addTick(key, price);\endcode
+*/
+
+/*!
+  Constructs a financial chart which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The constructed QCPFinancial can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
+  then takes ownership of the financial chart.
+*/
+QCPFinancial::QCPFinancial(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis),
+  mChartStyle(csCandlestick),
+  mWidth(0.5),
+  mTwoColored(true),
+  mBrushPositive(QBrush(QColor(50, 160, 0))),
+  mBrushNegative(QBrush(QColor(180, 0, 15))),
+  mPenPositive(QPen(QColor(40, 150, 0))),
+  mPenNegative(QPen(QColor(170, 5, 5))),
+  mCurrentIndex(-1)
+{
+  mPen.setColor(Qt::black);
+  mBrush = QBrush(Qt::NoBrush);
+  mSelectedPen = QPen(QColor(80, 80, 255), 2.5);
+  mSelectedBrush = QBrush(QColor(80, 80, 255));
+}
+
+QCPFinancial::~QCPFinancial()
+{
+}
+
+/*!
+  Replaces the current data with the provided \a data. The data points in \a data must be sorted
+  ascending by key.
+  
+  \see addData, addTick
+*/
+void QCPFinancial::setData(const QCPFinancialDataVector &data)
+{
+  mData = data;
+  mCurrentIndex = -1;
+}
+
+/*! \overload
+  
+  Replaces the current data with the provided open/high/low/close data. The provided vectors should
+  have equal length. Else, the number of added points will be the size of the smallest vector. The
+  keys in \a key must be sorted ascending.
+*/
+void QCPFinancial::setData(const QVector<double> &key, const QVector<double> &open, const QVector<double> &high, const QVector<double> &low, const QVector<double> &close)
+{
+  int n = key.size();
+  n = qMin(n, open.size());
+  n = qMin(n, high.size());
+  n = qMin(n, low.size());
+  n = qMin(n, close.size());
+  mData.resize(n);
+  for (int i=0; i<n; ++i)
+    mData[i] = QCPFinancialData(key[i], open[i], high[i], low[i], close[i]);
+  mCurrentIndex = -1;
+}
+
+/*!
+  Sets which representation style shall be used to display the OHLC data.
+*/
+void QCPFinancial::setChartStyle(QCPFinancial::ChartStyle style)
+{
+  mChartStyle = style;
+}
+
+/*!
+  Sets the width of the individual bars/candlesticks to \a width in plot key coordinates.
+  
+  A typical choice is to set it to (or slightly less than) one bin interval width.
+*/
+void QCPFinancial::setWidth(double width)
+{
+  mWidth = width;
+}
+
+/*!
+  Sets whether this chart shall contrast positive from negative trends per data point by using two
+  separate colors to draw the respective bars/candlesticks.
+  
+  If \a twoColored is false, the normal plottable's pen and brush are used (\ref setPen, \ref
+  setBrush).
+  
+  \see setPenPositive, setPenNegative, setBrushPositive, setBrushNegative
+*/
+void QCPFinancial::setTwoColored(bool twoColored)
+{
+  mTwoColored = twoColored;
+}
+
+/*!
+  If \ref setTwoColored is set to true, this function controls the brush that is used to draw fills
+  of data points with a positive trend (i.e. bars/candlesticks with close >= open).
+  
+  \see setBrushNegative, setPenPositive, setPenNegative
+*/
+void QCPFinancial::setBrushPositive(const QBrush &brush)
+{
+  mBrushPositive = brush;
+}
+
+/*!
+  If \ref setTwoColored is set to true, this function controls the brush that is used to draw fills
+  of data points with a negative trend (i.e. bars/candlesticks with close < open).
+  
+  \see setBrushPositive, setPenNegative, setPenPositive
+*/
+void QCPFinancial::setBrushNegative(const QBrush &brush)
+{
+  mBrushNegative = brush;
+}
+
+/*!
+  If \ref setTwoColored is set to true, this function controls the pen that is used to draw
+  outlines of data points with a positive trend (i.e. bars/candlesticks with close >= open).
+  
+  \see setPenNegative, setBrushPositive, setBrushNegative
+*/
+void QCPFinancial::setPenPositive(const QPen &pen)
+{
+  mPenPositive = pen;
+}
+
+/*!
+  If \ref setTwoColored is set to true, this function controls the pen that is used to draw
+  outlines of data points with a negative trend (i.e. bars/candlesticks with close < open).
+  
+  \see setPenPositive, setBrushNegative, setBrushPositive
+*/
+void QCPFinancial::setPenNegative(const QPen &pen)
+{
+  mPenNegative = pen;
+}
+
+/*!
+  Adds the provided single data point in \a data to the current data. If a data point with the same
+  key already exists, it is replaced. Appending at the end (the common case for streaming data)
+  doesn't require a search.
+  
+  \see addTick, removeDataBefore, removeDataAfter
+*/
+void QCPFinancial::addData(const QCPFinancialData &data)
+{
+  if (mData.isEmpty() || mData.last().key < data.key)
+  {
+    mData.append(data);
+    mCurrentIndex = mData.size()-1;
+    return;
+  }
+  int index = findIndex(data.key);
+  if (index < mData.size() && mData.at(index).key == data.key)
+    mData[index] = data;
+  else
+    mData.insert(index, data);
+  mCurrentIndex = index;
+}
+
+/*! \overload
+  
+  Adds the provided single data point given by \a key, \a open, \a high, \a low, and \a close to
+  the current data.
+*/
+void QCPFinancial::addData(double key, double open, double high, double low, double close)
+{
+  addData(QCPFinancialData(key, open, high, low, close));
+}
+
+/*!
+  Feeds a single tick with \a value into the candle at \a key. The key is chosen by the caller and
+  may be any key that identifies the candle, e.g. the start or the center of its bin interval, as
+  long as all ticks of one candle are fed with the same key. The candle is drawn centered at \a key.
+  
+  If \a key is the key of the candle that was last fed, only its high, low and close values are
+  updated. Otherwise a new candle is started at \a key with all four values set to \a value, which
+  replaces any old candle with the same key. This way, ring-buffer style charts that wrap around
+  to the start of the key axis can be fed without clearing the data first.
+  
+  Returns true if a new candle was started.
+  
+  \see addData
+*/
+bool QCPFinancial::addTick(double key, double value)
+{
+  if (mCurrentIndex >= 0 && mCurrentIndex < mData.size() && mData.at(mCurrentIndex).key == key)
+  {
+    QCPFinancialData &current = mData[mCurrentIndex];
+    if (value > current.high)
+      current.high = value;
+    if (value < current.low)
+      current.low = value;
+    current.close = value;
+    return false;
+  }
+  addData(QCPFinancialData(key, value, value, value, value));
+  return true;
+}
+
+/*!
+  Removes all data points with key smaller than \a key.
+  \see addData, clearData
+*/
+void QCPFinancial::removeDataBefore(double key)
+{
+  int index = findIndex(key);
+  if (index > 0)
+  {
+    mData.remove(0, index);
+    mCurrentIndex = -1;
+  }
+}
+
+/*!
+  Removes all data points with key greater than \a key.
+  \see addData, clearData
+*/
+void QCPFinancial::removeDataAfter(double key)
+{
+  int index = findIndex(key);
+  if (index < mData.size() && mData.at(index).key == key)
+    ++index;
+  if (index < mData.size())
+  {
+    mData.remove(index, mData.size()-index);
+    mCurrentIndex = -1;
+  }
+}
+
+/*!
+  Reserves storage for \a size data points, so streaming data into the chart with \ref addTick
+  doesn't reallocate the backing store until that many candles exist.
+*/
+void QCPFinancial::reserve(int size)
+{
+  mData.reserve(size);
+}
+
+/*!
+  Removes all data points.
+  \see removeDataBefore, removeDataAfter
+*/
+void QCPFinancial::clearData()
+{
+  mData.resize(0);
+  mCurrentIndex = -1;
+}
+
+/* inherits documentation from base class */
+double QCPFinancial::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+  Q_UNUSED(details)
+  if (onlySelectable && !mSelectable)
+    return -1;
+  if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1; }
+  if (mData.isEmpty())
+    return -1;
+  
+  double posKey, posValue;
+  pixelsToCoords(pos, posKey, posValue);
+  // the only candles that can contain posKey start at most half a width before it:
+  int index = findIndex(posKey-mWidth*0.5);
+  for (; index < mData.size() && mData.at(index).key-mWidth*0.5 <= posKey; ++index)
+  {
+    const QCPFinancialData &candle = mData.at(index);
+    if (QCPRange(candle.key-mWidth*0.5, candle.key+mWidth*0.5).contains(posKey) &&
+        QCPRange(candle.low, candle.high).contains(posValue))
+      return mParentPlot->selectionTolerance()*0.99;
+  }
+  return -1;
+}
+
+/* inherits documentation from base class */
+void QCPFinancial::draw(QCPPainter *painter)
+{
+  if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  if (mData.isEmpty()) return;
+  
+  int begin, end;
+  getVisibleDataBounds(begin, end);
+  if (begin >= end) return;
+  
+  if (mChartStyle == csOhlc)
+    drawOhlcPlot(painter, begin, end);
+  else
+    drawCandlestickPlot(painter, begin, end);
+}
+
+/* inherits documentation from base class */
+void QCPFinancial::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+  painter->setAntialiasing(false); // legend icon especially of csCandlestick looks better without antialiasing
+  if (mTwoColored)
+  {
+    painter->setPen(mPenPositive);
+    painter->setBrush(mBrushPositive);
+  } else
+  {
+    painter->setPen(mPen);
+    painter->setBrush(mBrush);
+  }
+  if (mChartStyle == csOhlc)
+  {
+    painter->drawLine(QLineF(rect.width()*0.5, rect.top(), rect.width()*0.5, rect.bottom()).translated(rect.topLeft()));
+    painter->drawLine(QLineF(rect.width()*0.2, rect.height()*0.3, rect.width()*0.5, rect.height()*0.3).translated(rect.topLeft()));
+    painter->drawLine(QLineF(rect.width()*0.8, rect.height()*0.5, rect.width()*0.5, rect.height()*0.5).translated(rect.topLeft()));
+  } else
+  {
+    painter->drawLine(QLineF(rect.width()*0.5, rect.top(), rect.width()*0.5, rect.bottom()).translated(rect.topLeft()));
+    painter->drawRect(QRectF(rect.width()*0.25, rect.height()*0.25, rect.width()*0.5, rect.height()*0.5).translated(rect.topLeft()));
+  }
+}
+
+/*! \internal
+  
+  Collects the OHLC bars of the data points in the index range [\a begin, \a end) into one line
+  batch per color and draws them.
+  
+  \see drawCandlestickPlot
+*/
+void QCPFinancial::drawOhlcPlot(QCPPainter *painter, int begin, int end)
+{
+  int lineCount[2] = {0, 0};
+  int bodyCount[2] = {0, 0};
+  for (int k=0; k<2; ++k)
+  {
+    if (mLineBuffer[k].size() < (end-begin)*3)
+      mLineBuffer[k].resize((end-begin)*3);
+  }
+  
+  for (int i=begin; i<end; ++i)
+  {
+    const QCPFinancialData &candle = mData.at(i);
+    int k = (mTwoColored && candle.close < candle.open) ? 1 : 0;
+    QLineF *lines = mLineBuffer[k].data() + lineCount[k];
+    // backbone, open tick to the left and close tick to the right:
+    lines[0].setPoints(coordsToPixels(candle.key, candle.high), coordsToPixels(candle.key, candle.low));
+    lines[1].setPoints(coordsToPixels(candle.key-mWidth*0.5, candle.open), coordsToPixels(candle.key, candle.open));
+    lines[2].setPoints(coordsToPixels(candle.key, candle.close), coordsToPixels(candle.key+mWidth*0.5, candle.close));
+    lineCount[k] += 3;
+  }
+  drawBatches(painter, lineCount, bodyCount);
+}
+
+/*! \internal
+  
+  Collects the wicks and bodies of the candlesticks of the data points in the index range [\a
+  begin, \a end) into one line and one rect batch per color and draws them.
+  
+  \see drawOhlcPlot
+*/
+void QCPFinancial::drawCandlestickPlot(QCPPainter *painter, int begin, int end)
+{
+  int lineCount[2] = {0, 0};
+  int bodyCount[2] = {0, 0};
+  for (int k=0; k<2; ++k)
+  {
+    if (mLineBuffer[k].size() < (end-begin)*2)
+      mLineBuffer[k].resize((end-begin)*2);
+    if (mBodyBuffer[k].size() < end-begin)
+      mBodyBuffer[k].resize(end-begin);
+  }
+  
+  for (int i=begin; i<end; ++i)
+  {
+    const QCPFinancialData &candle = mData.at(i);
+    int k = (mTwoColored && candle.close < candle.open) ? 1 : 0;
+    // upper and lower wick, so they don't shine through transparent bodies:
+    double bodyTop = qMax(candle.open, candle.close);
+    double bodyBottom = qMin(candle.open, candle.close);
+    QLineF *lines = mLineBuffer[k].data() + lineCount[k];
+    lines[0].setPoints(coordsToPixels(candle.key, candle.high), coordsToPixels(candle.key, bodyTop));
+    lines[1].setPoints(coordsToPixels(candle.key, bodyBottom), coordsToPixels(candle.key, candle.low));
+    lineCount[k] += 2;
+    mBodyBuffer[k][bodyCount[k]++] = QRectF(coordsToPixels(candle.key-mWidth*0.5, candle.close), coordsToPixels(candle.key+mWidth*0.5, candle.open)).normalized();
+  }
+  drawBatches(painter, lineCount, bodyCount);
+}
+
+/*! \internal
+  
+  Draws the first \a lineCount lines and \a bodyCount rects of the positive (index 0) and negative
+  (index 1) batch buffers, using one drawLines and one drawRects call per color.
+*/
+void QCPFinancial::drawBatches(QCPPainter *painter, const int *lineCount, const int *bodyCount)
+{
+  for (int k=0; k<2; ++k)
+  {
+    if (lineCount[k] == 0 && bodyCount[k] == 0)
+      continue;
+    if (mSelected || !mTwoColored)
+    {
+      painter->setPen(mainPen());
+      painter->setBrush(mainBrush());
+    } else
+    {
+      painter->setPen(k == 0 ? mPenPositive : mPenNegative);
+      painter->setBrush(k == 0 ? mBrushPositive : mBrushNegative);
+    }
+    applyDefaultAntialiasingHint(painter);
+    if (lineCount[k] > 0)
+      painter->drawLines(mLineBuffer[k].constData(), lineCount[k]);
+    if (bodyCount[k] > 0)
+      painter->drawRects(mBodyBuffer[k].constData(), bodyCount[k]);
+  }
+}
+
+/*! \internal
+  
+  Returns the index of the first data point whose key is not smaller than \a key, or the data size
+  if there is no such data point. This is a binary search on the sorted data vector.
+*/
+int QCPFinancial::findIndex(double key) const
+{
+  int lower = 0;
+  int upper = mData.size();
+  while (lower < upper)
+  {
+    int middle = lower + (upper-lower)/2;
+    if (mData.at(middle).key < key)
+      lower = middle+1;
+    else
+      upper = middle;
+  }
+  return lower;
+}
+
+/*! \internal
+  
+  Determines the index range [\a begin, \a end) of data points that are (at least partially)
+  visible in the current key axis range.
+*/
+void QCPFinancial::getVisibleDataBounds(int &begin, int &end) const
+{
+  QCPRange keyRange = mKeyAxis.data()->range();
+  begin = findIndex(keyRange.lower-mWidth*0.5);
+  end = findIndex(keyRange.upper+mWidth*0.5);
+  if (end < mData.size() && mData.at(end).key-mWidth*0.5 <= keyRange.upper)
+    ++end;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPFinancial::getKeyRange(bool &validRange, SignDomain inSignDomain) const
+{
+  QCPRange range;
+  bool haveLower = false;
+  bool haveUpper = false;
+  
+  double current;
+  for (int i=0; i<mData.size(); ++i)
+  {
+    current = mData.at(i).key;
+    if (inSignDomain == sdBoth || (inSignDomain == sdNegative && current < 0) || (inSignDomain == sdPositive && current > 0))
+    {
+      if (current < range.lower || !haveLower)
+      {
+        range.lower = current;
+        haveLower = true;
+      }
+      if (current > range.upper || !haveUpper)
+      {
+        range.upper = current;
+        haveUpper = true;
+      }
+    }
+  }
+  // add half width of candles at both ends:
+  if (haveUpper && inSignDomain != sdNegative && range.upper+mWidth*0.5 > range.upper)
+    range.upper += mWidth*0.5;
+  if (haveLower && inSignDomain != sdPositive && range.lower-mWidth*0.5 < range.lower)
+    range.lower -= mWidth*0.5;
+  
+  validRange = haveLower && haveUpper;
+  return range;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPFinancial::getValueRange(bool &validRange, SignDomain inSignDomain) const
+{
+  QCPRange range;
+  bool haveLower = false;
+  bool haveUpper = false;
+  
+  for (int i=0; i<mData.size(); ++i)
+  {
+    const QCPFinancialData &candle = mData.at(i);
+    // high and low bound all other values of the candle:
+    if (inSignDomain == sdBoth || (inSignDomain == sdNegative && candle.high < 0) || (inSignDomain == sdPositive && candle.high > 0))
+    {
+      if (candle.high > range.upper || !haveUpper)
+      {
+        range.upper = candle.high;
+        haveUpper = true;
+      }
+    }
+    if (inSignDomain == sdBoth || (inSignDomain == sdNegative && candle.low < 0) || (inSignDomain == sdPositive && candle.low > 0))
+    {
+      if (candle.low < range.lower || !haveLower)
+      {
+        range.lower = candle.low;
+        haveLower = true;
+      }
+    }
+  }
+  
+  validRange = haveLower && haveUpper;
+  return range;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPItemStraightLine
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -43,6 +43,7 @@
 #include <QStack>
 #include <QCache>
 #include <QMargins>
+#include <QTimer>
 #include <qmath.h>
 #include <limits>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
@@ -365,8 +366,19 @@ class QCP_LIB_DECL QCPLayer : public QObject
   Q_PROPERTY(QString name READ name)
   Q_PROPERTY(int index READ index)
   Q_PROPERTY(QList<QCPLayerable*> children READ children)
+  Q_PROPERTY(LayerMode mode READ mode WRITE setMode)
   /// \endcond
 public:
+  /*!
+    Defines how the layer is rendered by its parent plot.
+    
+    \see setMode
+  */
+  enum LayerMode { lmLogical   ///< Layer is drawn into the main paint buffer of the parent plot, together with all other logical layers
+                   ,lmBuffered ///< Layer has its own paint buffer which is composited on top of the main paint buffer. It may be replotted individually with \ref replot
+                 };
+  Q_ENUMS(LayerMode)
+  
   QCPLayer(QCustomPlot* parentPlot, const QString &layerName);
   ~QCPLayer();
   
@@ -375,6 +387,13 @@ public:
   QString name() const { return mName; }
   int index() const { return mIndex; }
   QList<QCPLayerable*> children() const { return mChildren; }
+  LayerMode mode() const { return mMode; }
+  
+  // setters:
+  void setMode(LayerMode mode);
+  
+  // non-property methods:
+  void replot();
   
 protected:
   // property members:
@@ -382,10 +401,17 @@ protected:
   QString mName;
   int mIndex;
   QList<QCPLayerable*> mChildren;
+  LayerMode mMode;
+  
+  // non-property members:
+  QPixmap mPaintBuffer;
+  const char *mTraceName; // span name of draw, interned once since the layer name never changes
   
   // non-virtual methods:
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
+  void draw(QCPPainter *painter);
+  void drawToPaintBuffer();
   
 private:
   Q_DISABLE_COPY(QCPLayer)
@@ -455,6 +481,7 @@ private:
   Q_DISABLE_COPY(QCPLayerable)
   
   friend class QCustomPlot;
+  friend class QCPLayer;
   friend class QCPAxisRect;
 };
 
@@ -476,6 +503,9 @@ public:
   QCPRange sanitizedForLinScale() const;
   bool contains(double value) const;
   
+  bool operator==(const QCPRange& other) const { return lower == other.lower && upper == other.upper; }
+  bool operator!=(const QCPRange& other) const { return !(*this == other); }
+  
   static bool validRange(double lower, double upper);
   static bool validRange(const QCPRange &range);
   static const double minRange; //1e-280;
@@ -1497,6 +1527,19 @@ public:
                        };
   Q_ENUMS(LayerInsertMode)
   
+  /*!
+    Defines with what timing the QCustomPlot surface is refreshed after a replot, or whether the
+    replot is deferred to the event loop.
+
+    \see replot
+  */
+  enum RefreshPriority { rpImmediateRefresh ///< Replots right away and repaints the widget surface immediately (repaint())
+                         ,rpQueuedRefresh   ///< Replots right away and schedules a repaint of the widget surface (update())
+                         ,rpRefreshHint     ///< Replots right away, whether to repaint immediately is decided by the \ref QCP::phForceRepaint plotting hint
+                         ,rpQueuedReplot    ///< Only marks the plot as outdated. The replot happens once control returns to the event loop, coalescing all queued replot requests until then
+                       };
+  Q_ENUMS(RefreshPriority)
+  
   explicit QCustomPlot(QWidget *parent = 0);
   virtual ~QCustomPlot();
   
@@ -1598,8 +1641,9 @@ public:
   bool saveBmp(const QString &fileName, int width=0, int height=0, double scale=1.0);
   bool saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality=-1);
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
+  QImage toImage(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
-  Q_SLOT void replot();
+  Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpRefreshHint);
   
   QCPAxis *xAxis, *yAxis, *xAxis2, *yAxis2;
   QCPLegend *legend;
@@ -1653,6 +1697,7 @@ protected:
   QPoint mMousePressPos;
   QCPLayoutElement *mMouseEventElement;
   bool mReplotting;
+  bool mReplotQueued;
   
   // reimplemented virtual methods:
   virtual QSize minimumSizeHint() const;
@@ -1674,6 +1719,7 @@ protected:
   void updateLayerIndices() const;
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
   void drawBackground(QCPPainter *painter);
+  Q_SLOT void processQueuedReplot();
   
   friend class QCPLegend;
   friend class QCPAxis;
@@ -1781,6 +1827,7 @@ public:
   void addData(const QCPData &data);
   void addData(double key, double value);
   void addData(const QVector<double> &keys, const QVector<double> &values);
+  bool setDataValue(double key, double value);
   void removeDataBefore(double key);
   void removeDataAfter(double key);
   void removeData(double fromKey, double toKey);
@@ -1841,6 +1888,24 @@ protected:
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
   int findIndexAboveY(const QVector<QPointF> *data, double y) const;
   double pointDistance(const QPointF &pixelPoint) const;
+  int segmentGridCell(double pixel, double origin, int cellCount) const;
+  bool segmentIndexUpToDate() const;
+  void updateSegmentIndex() const;
+  
+  // non-property members (reused by draw, so a replot doesn't allocate them anew):
+  QVector<QPointF> mLineBuffer;
+  QVector<QCPData> mPointBuffer;
+  
+  // non-property members (pixel-space segment index used by pointDistance):
+  mutable bool mSegmentIndexValid;
+  mutable bool mSegmentPairwise;
+  mutable QVector<QPointF> mSegmentPoints;
+  mutable QVector<int> mSegmentCellStart, mSegmentCellEntries;
+  mutable QRect mSegmentGridRect;
+  mutable int mSegmentGridColumns, mSegmentGridRows, mSegmentCellSize;
+  mutable QCPRange mSegmentKeyRange, mSegmentValueRange;
+  mutable QPointF mSegmentReference[3];
+  mutable LineStyle mSegmentLineStyle;
   
   friend class QCustomPlot;
   friend class QCPLegend;
@@ -2116,6 +2181,122 @@ protected:
 };
 
 
+/*! \file */
+
+
+
+class QCP_LIB_DECL QCPFinancialData
+{
+public:
+  QCPFinancialData();
+  QCPFinancialData(double key, double open, double high, double low, double close);
+  double key, open, high, low, close;
+};
+Q_DECLARE_TYPEINFO(QCPFinancialData, Q_MOVABLE_TYPE);
+
+/*! \typedef QCPFinancialDataVector
+  Container for storing QCPFinancialData items in a contiguous fashion, sorted ascending by the
+  key member of the QCPFinancialData instances.
+  
+  This is the container in which QCPFinancial holds its data.
+  \see QCPFinancialData, QCPFinancial::setData
+*/
+typedef QVector<QCPFinancialData> QCPFinancialDataVector;
+
+
+class QCP_LIB_DECL QCPFinancial : public QCPAbstractPlottable
+{
+  Q_OBJECT
+  /// \cond INCLUDE_QPROPERTIES
+  Q_PROPERTY(ChartStyle chartStyle READ chartStyle WRITE setChartStyle)
+  Q_PROPERTY(double width READ width WRITE setWidth)
+  Q_PROPERTY(bool twoColored READ twoColored WRITE setTwoColored)
+  Q_PROPERTY(QBrush brushPositive READ brushPositive WRITE setBrushPositive)
+  Q_PROPERTY(QBrush brushNegative READ brushNegative WRITE setBrushNegative)
+  Q_PROPERTY(QPen penPositive READ penPositive WRITE setPenPositive)
+  Q_PROPERTY(QPen penNegative READ penNegative WRITE setPenNegative)
+  /// \endcond
+public:
+  /*!
+    Defines the possible representations of OHLC data in the plot.
+    
+    \see setChartStyle
+  */
+  enum ChartStyle { csOhlc         ///< Open-High-Low-Close bar representation
+                   ,csCandlestick  ///< Candlestick representation
+                  };
+  Q_ENUMS(ChartStyle)
+  
+  explicit QCPFinancial(QCPAxis *keyAxis, QCPAxis *valueAxis);
+  virtual ~QCPFinancial();
+  
+  // getters:
+  const QCPFinancialDataVector *data() const { return &mData; }
+  ChartStyle chartStyle() const { return mChartStyle; }
+  double width() const { return mWidth; }
+  bool twoColored() const { return mTwoColored; }
+  QBrush brushPositive() const { return mBrushPositive; }
+  QBrush brushNegative() const { return mBrushNegative; }
+  QPen penPositive() const { return mPenPositive; }
+  QPen penNegative() const { return mPenNegative; }
+  
+  // setters:
+  void setData(const QCPFinancialDataVector &data);
+  void setData(const QVector<double> &key, const QVector<double> &open, const QVector<double> &high, const QVector<double> &low, const QVector<double> &close);
+  void setChartStyle(ChartStyle style);
+  void setWidth(double width);
+  void setTwoColored(bool twoColored);
+  void setBrushPositive(const QBrush &brush);
+  void setBrushNegative(const QBrush &brush);
+  void setPenPositive(const QPen &pen);
+  void setPenNegative(const QPen &pen);
+  
+  // non-property methods:
+  void addData(const QCPFinancialData &data);
+  void addData(double key, double open, double high, double low, double close);
+  bool addTick(double key, double value);
+  void removeDataBefore(double key);
+  void removeDataAfter(double key);
+  void reserve(int size);
+  
+  // reimplemented virtual methods:
+  virtual void clearData();
+  virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const;
+  
+protected:
+  // property members:
+  QCPFinancialDataVector mData;
+  ChartStyle mChartStyle;
+  double mWidth;
+  bool mTwoColored;
+  QBrush mBrushPositive, mBrushNegative;
+  QPen mPenPositive, mPenNegative;
+  
+  // non-property members:
+  int mCurrentIndex;
+  QVector<QRectF> mBodyBuffer[2];
+  QVector<QLineF> mLineBuffer[2];
+  
+  // reimplemented virtual methods:
+  virtual void draw(QCPPainter *painter);
+  virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
+  virtual QCPRange getKeyRange(bool &validRange, SignDomain inSignDomain=sdBoth) const;
+  virtual QCPRange getValueRange(bool &validRange, SignDomain inSignDomain=sdBoth) const;
+  
+  // introduced virtual methods:
+  virtual void drawOhlcPlot(QCPPainter *painter, int begin, int end);
+  virtual void drawCandlestickPlot(QCPPainter *painter, int begin, int end);
+  
+  // non-virtual methods:
+  int findIndex(double key) const;
+  void getVisibleDataBounds(int &begin, int &end) const;
+  void drawBatches(QCPPainter *painter, const int *lineCount, const int *bodyCount);
+  
+  friend class QCustomPlot;
+  friend class QCPLegend;
+};
+
+
 class QCP_LIB_DECL QCPItemStraightLine : public QCPAbstractItem
 {
   Q_OBJECT
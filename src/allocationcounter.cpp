@@ -0,0 +1,150 @@
+#include <allocationcounter.h>
+
+#ifdef STOCKTRADER_ALLOC_COUNT
+
+#include <metrics.h>
+#include <QTimer>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/*
+ * With glibc the malloc family itself is replaced, so the allocations of
+ * the Qt containers (which call malloc directly) are counted as well as
+ * operator new. Elsewhere only operator new is counted.
+ */
+
+static std::atomic<quint64> allocations[allocation_phase_count];
+static thread_local AllocationPhase current_phase = phase_other;
+
+static inline void countAllocation(void)
+{
+    allocations[current_phase].fetch_add(1,std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope(AllocationPhase phase) :
+    previous(current_phase)
+{
+    current_phase = phase;
+}
+
+AllocationScope::~AllocationScope()
+{
+    current_phase = previous;
+}
+
+quint64 AllocationCounter::count(void)
+{
+    quint64 sum = 0;
+    for (int p = 0; p < allocation_phase_count; p++)
+        sum += allocations[p].load(std::memory_order_relaxed);
+
+    return sum;
+}
+
+quint64 AllocationCounter::count(AllocationPhase phase)
+{
+    return allocations[phase].load(std::memory_order_relaxed);
+}
+
+const char *AllocationCounter::phaseName(AllocationPhase phase)
+{
+    static const char *names[allocation_phase_count] = { "other", "event", "price_update", "set_data", "replot", "paint" };
+
+    return names[phase];
+}
+
+AllocationMonitor::AllocationMonitor(QTimer *frame_timer, QObject *parent) :
+    QObject(parent)
+{
+    for (int p = 0; p < allocation_phase_count; p++)
+    {
+        QString name = AllocationCounter::phaseName(AllocationPhase(p));
+
+        phases[p] = metrics.counter("stocktrader_allocations_" + name + "_total","Heap allocations in the " + name + " phase");
+        last[p] = AllocationCounter::count(AllocationPhase(p));
+    }
+
+    // Counts, not durations, so they are exposed unscaled
+    per_frame = metrics.histogram("stocktrader_allocations_per_frame","Heap allocations between two frames of the render timer",1);
+
+    QObject::connect(frame_timer,SIGNAL( timeout() ),this,SLOT( frame() ));
+}
+
+void AllocationMonitor::frame(void)
+{
+    quint64 frame_allocations = 0;
+
+    for (int p = 0; p < allocation_phase_count; p++)
+    {
+        quint64 current = AllocationCounter::count(AllocationPhase(p));
+
+        phases[p]->add(current - last[p]);
+        frame_allocations += current - last[p];
+        last[p] = current;
+    }
+
+    per_frame->record(frame_allocations);
+
+    return;
+}
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(n,size);
+}
+
+void *realloc(void *p, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(p,size);
+}
+
+}
+
+#else
+
+void *operator new(std::size_t size)
+{
+    countAllocation();
+
+    void *p = std::malloc(size ? size : 1);
+    if ( ! p )
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+#endif
+
+#endif // STOCKTRADER_ALLOC_COUNT
@@ -0,0 +1,170 @@
+#include <basketbook.h>
+#include <trace.h>
+
+BasketBook::BasketBook(int n) :
+    tickers(0)
+{
+    resize(n);
+}
+
+void BasketBook::resize(int n)
+{
+    tickers = n;
+
+    legs.clear();
+    first.fill(0,1);
+    memberships.clear();
+    member_first.fill(0,n + 1);
+
+    last.fill(Money(),n);
+    values.clear();
+    divisors.clear();
+
+    return;
+}
+
+// Only meant for setting up, the memberships of all tickers are rebuilt
+int BasketBook::define(const QVector<BasketLeg> &basket_legs)
+{
+    int b = size();
+    Money value;
+
+    for (int k = 0; k < basket_legs.size(); k++)
+    {
+        legs.append(basket_legs[k]);
+        value += basket_legs[k].shares * last[basket_legs[k].ticker];
+    }
+    first.append(legs.size());
+
+    values.append(value);
+    divisors.append(value.toDouble() / basket_index_base);
+
+    // Counting sort of the legs by ticker
+    member_first.fill(0,tickers + 1);
+    for (int k = 0; k < legs.size(); k++)
+        member_first[legs[k].ticker + 1]++;
+    for (int t = 0; t < tickers; t++)
+        member_first[t + 1] += member_first[t];
+
+    QVector<int> next = member_first;
+    memberships.resize(legs.size());
+
+    for (int basket = 0; basket < size(); basket++)
+        for (int k = first[basket]; k < first[basket + 1]; k++)
+        {
+            Membership &m = memberships[next[legs[k].ticker]++];
+            m.basket = basket;
+            m.leg = k;
+        }
+
+    return b;
+}
+
+int BasketBook::size(void) const
+{
+    return first.size() - 1;
+}
+
+int BasketBook::legCount(int b) const
+{
+    return first[b + 1] - first[b];
+}
+
+const BasketLeg &BasketBook::leg(int b, int k) const
+{
+    return legs[first[b] + k];
+}
+
+void BasketBook::split(int t, int ratio)
+{
+    reweight(t,ratio,1);
+
+    return;
+}
+
+// A leg keeps one share at least
+void BasketBook::consolidate(int t, int ratio)
+{
+    reweight(t,1,ratio);
+
+    return;
+}
+
+void BasketBook::update(const double *prices)
+{
+    TRACE_SPAN("BasketBook::update");
+
+    for (int t = 0; t < tickers; t++)
+    {
+        Money price = prices[t] > 0 ? Money::fromDouble(prices[t]) : Money();
+
+        if ( price == last[t] )
+            continue;
+
+        Money delta = price - last[t];
+        bool listed = last[t] == Money(); // the first price of a company doesn't move the index
+
+        for (int k = member_first[t]; k < member_first[t + 1]; k++)
+        {
+            const Membership &m = memberships[k];
+            Money before = values[m.basket];
+
+            values[m.basket] += legs[m.leg].shares * delta;
+            if ( listed )
+                rebase(m.basket,before);
+        }
+
+        last[t] = price;
+    }
+
+    return;
+}
+
+Money BasketBook::value(int b) const
+{
+    return values[b];
+}
+
+double BasketBook::index(int b) const
+{
+    if ( divisors[b] <= 0 )
+        return 0;
+
+    return values[b].toDouble() / divisors[b];
+}
+
+// Multiplies the shares of the legs of the ticker by num / den and its
+// price by den / num
+void BasketBook::reweight(int t, int num, int den)
+{
+    Money price = last[t].mulDiv(den,num);
+
+    for (int k = member_first[t]; k < member_first[t + 1]; k++)
+    {
+        const Membership &m = memberships[k];
+        BasketLeg &leg = legs[m.leg];
+        Money before = values[m.basket];
+
+        values[m.basket] -= leg.shares * last[t];
+        leg.shares = qMax(1,leg.shares * num / den);
+        values[m.basket] += leg.shares * price;
+
+        rebase(m.basket,before);
+    }
+
+    last[t] = price;
+
+    return;
+}
+
+// Keeps the index where it was before the value changed, or starts it at
+// basket_index_base
+void BasketBook::rebase(int b, Money before)
+{
+    if ( before > Money() && divisors[b] > 0 )
+        divisors[b] *= values[b].toDouble() / before.toDouble();
+    else
+        divisors[b] = values[b].toDouble() / basket_index_base;
+
+    return;
+}
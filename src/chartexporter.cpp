@@ -0,0 +1,117 @@
+#include <chartexporter.h>
+#include <qcustomplot.h>
+#include <QAtomicInt>
+#include <QDir>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+/*
+ * Encodes one rendered chart as PNG and writes it, then frees its slot.
+ */
+class ChartSaveTask : public QRunnable
+{
+public:
+    ChartSaveTask(const QImage &i, const QString &f, QAtomicInt *w, QSemaphore *s) :
+        image(i), file_name(f), written(w), in_flight(s)
+    {
+    }
+
+    void run(void)
+    {
+        if ( ! image.isNull() && image.save(file_name,"PNG") )
+            written->ref();
+
+        image = QImage(); // before the slot is free
+        in_flight->release();
+
+        return;
+    }
+
+private:
+    QImage image;
+    QString file_name;
+    QAtomicInt *written;
+    QSemaphore *in_flight;
+};
+
+ChartExporter::ChartExporter(int w, int h) :
+    width(w), height(h)
+{
+}
+
+void ChartExporter::addChart(const QString &name, const QVector<double> &prices)
+{
+    Chart chart;
+    chart.name = name;
+    chart.prices = prices;
+
+    charts.append(chart);
+
+    return;
+}
+
+// Blocks until all charts are written.
+int ChartExporter::exportCharts(const QString &path)
+{
+    QDir directory(path);
+    if ( charts.isEmpty() || ! directory.mkpath(".") )
+        return 0;
+
+    QCustomPlot *renderer = createRenderer();
+
+    QAtomicInt written(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1,QThread::idealThreadCount()));
+
+    // Rendering is faster than encoding, so it waits for a free slot to
+    // keep the number of images in memory bounded
+    QSemaphore in_flight(images_in_flight_per_thread * pool.maxThreadCount());
+
+    // The renderer stays in this thread, the pool encodes meanwhile
+    for (int i = 0; i < charts.size(); i++)
+    {
+        const Chart &chart = charts.at(i);
+        QString file_name = directory.filePath(QString("%1_%2.png").arg(i).arg(chart.name));
+
+        in_flight.acquire();
+        pool.start(new ChartSaveTask(renderChart(renderer,chart,width,height),file_name,&written,&in_flight));
+    }
+
+    pool.waitForDone();
+
+    delete renderer;
+
+    return written.fetchAndAddRelaxed(0);
+}
+
+QCustomPlot *ChartExporter::createRenderer(void)
+{
+    QCustomPlot *renderer = new QCustomPlot;
+
+    renderer->plotLayout()->insertRow(0);
+    renderer->plotLayout()->addElement(0,0,new QCPPlotTitle(renderer));
+
+    renderer->addGraph();
+    renderer->graph(0)->setPen(QPen(Qt::red));
+    renderer->graph(0)->setBrush(QBrush(QColor(255,0,0,30)));
+    renderer->xAxis->setLabel("Tick");
+    renderer->yAxis->setLabel("Price");
+
+    return renderer;
+}
+
+// Only in the GUI thread, like every use of the renderer
+QImage ChartExporter::renderChart(QCustomPlot *renderer, const Chart &chart, int width, int height)
+{
+    QVector<double> x(chart.prices.size());
+    for (int i = 0; i < x.size(); i++)
+        x[i] = i;
+
+    qobject_cast<QCPPlotTitle*>(renderer->plotLayout()->element(0,0))->setText(chart.name);
+    renderer->graph(0)->setData(x,chart.prices);
+    renderer->rescaleAxes();
+
+    return renderer->toImage(width,height);
+}
@@ -1,18 +1,18 @@
 #include <company.h>
 #include <localpricegen.h>
 #include <mainwindow.h>
+#include <trace.h>
 
 
 Company::Company(void) :
-    current_price(0), shares_in_depot(0), total_value(0),
-    ymax(0), is_bankrupt(false), splitted(false)
+    shares_in_depot(0),
+    ymax(0)
 {
     QObject::connect(&trend_adapt_timer,SIGNAL( timeout() ),&price_generator,SLOT( newTrendCoeff() ));
 }
 
 void Company::initCompany(double my)
 {
-    is_bankrupt = false;
     price_generator.setRange(my);
     ymax = price_generator.getRange();
 
@@ -21,65 +21,114 @@ void Company::initCompany(double my)
 
 double Company::updatePrice(void)
 {
-    current_price = price_generator.getPrice();
+    TRACE_SPAN("Company::updatePrice");
 
-    if (current_price <= 0.02 * ymax)
-    {
-        is_bankrupt = true;
-        current_price = shares_in_depot = total_value = 0;
-    }
-    else if (current_price >= 0.97 * ymax)
-    {
-        split();
-    }
+    current_price = Money::fromDouble(price_generator.getPrice());
 
-    recalcAvg();
+    return current_price.toDouble();
+}
 
+Money Company::getPrice(void)
+{
     return current_price;
 }
 
-double Company::getPrice(void)
+int Company::getShares(void)
 {
-    return current_price;
+    return shares_in_depot;
+}
+
+Money Company::getAvgPrice(void)
+{
+    return avg_depot_price;
+}
+
+void Company::split(int ratio)
+{
+    shares_in_depot *= ratio;
+    lots.split(ratio);
+    recalcAvg();
+
+    setPrice(current_price / ratio);
+
+    return;
+}
+
+void Company::consolidate(int ratio)
+{
+    shares_in_depot /= ratio;
+    lots.consolidate(ratio);
+    recalcAvg();
+
+    setPrice(ratio * current_price);
+
+    return;
 }
 
-void Company::split(void)
+// The price drops by what was paid out
+void Company::exDividend(Money amount)
 {
-    current_price /= 2;
-    shares_in_depot *= 2;
+    setPrice(current_price - amount);
 
-    avg_depot_price = total_value / shares_in_depot;
+    return;
+}
 
-    splitted = true;
+// The shares in the depot are lost
+void Company::delist(void)
+{
+    current_price = Money();
+    shares_in_depot = 0;
+    lots.clear();
+    recalcAvg();
+
+    return;
+}
 
-    price_generator.setPrice(current_price);
+// The price generator goes on from the given price
+void Company::setPrice(Money price)
+{
+    current_price = price;
+    price_generator.setPrice(current_price.toDouble());
 
     return;
 }
 
-void Company::buy(int n)
+void Company::buy(int n, Money price)
 {
     shares_in_depot += n;
-    total_value += n * current_price;
+    lots.buy(n,n * price);
 
     recalcAvg();
     return;
 }
 
-void Company::sell(int n)
+Money Company::sell(int n)
 {
-    total_value -= n * (total_value / shares_in_depot);
+    Money cost = lots.sell(n);
     shares_in_depot -= n;
 
     recalcAvg();
+    return cost;
+}
+
+// Only changes how later sales are relieved
+void Company::setCostBasis(CostBasis method)
+{
+    lots.setMethod(method);
+
     return;
 }
 
+const LotQueue &Company::getLots(void) const
+{
+    return lots;
+}
+
 void Company::recalcAvg(void)
 {
     if ( shares_in_depot > 0)
-        avg_depot_price = total_value / shares_in_depot;
-    else avg_depot_price = 0;
+        avg_depot_price = lots.cost() / shares_in_depot;
+    else avg_depot_price = Money();
 
     return;
 }
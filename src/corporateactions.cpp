@@ -0,0 +1,55 @@
+#include <corporateactions.h>
+#include <algorithm>
+
+// The heap keeps the greatest element first, so the later action is the lesser one
+static bool later(const CorporateAction &a, const CorporateAction &b)
+{
+    if ( a.tick != b.tick )
+        return a.tick > b.tick;
+
+    return a.sequence > b.sequence;
+}
+
+CorporateActions::CorporateActions(void) :
+    sequence(0)
+{
+}
+
+void CorporateActions::clear(int capacity)
+{
+    heap.clear();
+    heap.reserve(capacity);
+    sequence = 0;
+
+    return;
+}
+
+void CorporateActions::schedule(int tick, int ticker, CorporateAction::Type type, int listing, int ratio)
+{
+    CorporateAction action = { tick, ticker, type, ratio, listing, ++sequence };
+
+    heap.append(action);
+    std::push_heap(heap.begin(),heap.end(),later);
+
+    return;
+}
+
+bool CorporateActions::due(int tick) const
+{
+    return ! heap.isEmpty() && heap.first().tick <= tick;
+}
+
+CorporateAction CorporateActions::take(void)
+{
+    std::pop_heap(heap.begin(),heap.end(),later);
+
+    CorporateAction action = heap.last();
+    heap.removeLast();
+
+    return action;
+}
+
+int CorporateActions::size(void) const
+{
+    return heap.size();
+}
@@ -0,0 +1,171 @@
+#include <indicatorbank.h>
+#include <qmath.h>
+
+IndicatorBank::IndicatorBank(int n, int p, double bw) :
+    tickers(0), period(p), band_width(bw),
+    ema_alpha(2.0 / (p + 1)), head(0)
+{
+    resize(n);
+}
+
+void IndicatorBank::resize(int n)
+{
+    tickers = n;
+    head = 0;
+
+    window.fill(0, tickers * period);
+    count.fill(0, tickers);
+    sum.fill(0, tickers);
+    sum_sq.fill(0, tickers);
+    ema.fill(0, tickers);
+    last_price.fill(0, tickers);
+    avg_gain.fill(0, tickers);
+    avg_loss.fill(0, tickers);
+    sma.fill(0, tickers);
+    upper_band.fill(0, tickers);
+    lower_band.fill(0, tickers);
+    rsi.fill(50, tickers);
+
+    return;
+}
+
+// Forgets the history of one ticker, e.g. when a new company is placed on it
+void IndicatorBank::reset(int t)
+{
+    for (int row = 0; row < period; row++)
+        window[row * tickers + t] = 0;
+
+    count[t] = 0;
+    sum[t] = sum_sq[t] = ema[t] = last_price[t] = 0;
+    avg_gain[t] = avg_loss[t] = 0;
+    sma[t] = upper_band[t] = lower_band[t] = 0;
+    rsi[t] = 50;
+
+    return;
+}
+
+// Rescales the stored history of one ticker. Only happens on splits, so O(period) is fine.
+void IndicatorBank::scale(int t, double f)
+{
+    for (int row = 0; row < period; row++)
+        window[row * tickers + t] *= f;
+
+    sum[t] *= f;
+    sum_sq[t] *= f * f;
+    ema[t] *= f;
+    last_price[t] *= f;
+    avg_gain[t] *= f;
+    avg_loss[t] *= f;
+    sma[t] *= f;
+    upper_band[t] *= f;
+    lower_band[t] *= f;
+
+    return;
+}
+
+void IndicatorBank::update(const double *prices)
+{
+    double *slot = window.data() + head * tickers;
+
+    for (int t = 0; t < tickers; t++)
+    {
+        double p = prices[t];
+
+        // No price (delisted, or relisted in this tick) is no sample. The
+        // slot keeps its value, which is still in the sums.
+        if (p <= 0)
+            continue;
+
+        double old = slot[t]; // zero as long as the window is not full
+        int n = ++count[t];
+
+        sum[t] += p - old;
+        sum_sq[t] += p * p - old * old;
+        slot[t] = p;
+
+        double samples = n < period ? n : period;
+        double mean = sum[t] / samples;
+        double variance = sum_sq[t] / samples - mean * mean;
+        double deviation = variance > 0 ? qSqrt(variance) : 0;
+
+        sma[t] = mean;
+        upper_band[t] = mean + band_width * deviation;
+        lower_band[t] = mean - band_width * deviation;
+
+        ema[t] = n == 1 ? p : ema[t] + ema_alpha * (p - ema[t]);
+
+        // RSI: plain average over the first period changes, Wilder's smoothing afterwards
+        if (n > 1)
+        {
+            double change = p - last_price[t];
+            double gain = change > 0 ? change : 0;
+            double loss = change < 0 ? -change : 0;
+            double k = n - 1 < period ? 1.0 / (n - 1) : 1.0 / period;
+
+            avg_gain[t] += k * (gain - avg_gain[t]);
+            avg_loss[t] += k * (loss - avg_loss[t]);
+
+            rsi[t] = avg_loss[t] > 0 ? 100 - 100 / (1 + avg_gain[t] / avg_loss[t]) : 100;
+        }
+        last_price[t] = p;
+    }
+
+    if (++head == period)
+    {
+        head = 0;
+        resync();
+    }
+
+    return;
+}
+
+// The running sums drift by rounding errors. Recomputing them once per period
+// keeps them exact at an amortized cost of O(1) per tick.
+void IndicatorBank::resync(void)
+{
+    sum.fill(0);
+    sum_sq.fill(0);
+
+    for (int row = 0; row < period; row++)
+    {
+        const double *slot = window.constData() + row * tickers;
+
+        for (int t = 0; t < tickers; t++)
+        {
+            sum[t] += slot[t];
+            sum_sq[t] += slot[t] * slot[t];
+        }
+    }
+
+    return;
+}
+
+double IndicatorBank::value(Indicator which, int t) const
+{
+    switch (which)
+    {
+    case SMA: return sma[t];
+    case EMA: return ema[t];
+    case UpperBand: return upper_band[t];
+    case LowerBand: return lower_band[t];
+    case RSI: return rsi[t];
+    }
+
+    return 0;
+}
+
+// True as soon as a full period of prices has been seen
+bool IndicatorBank::isReady(int t) const
+{
+    return count[t] >= period;
+}
+
+int IndicatorBank::getPeriod(void) const
+{
+    return period;
+}
+
+int IndicatorBank::tickerCount(void) const
+{
+    return tickers;
+}
@@ -0,0 +1,113 @@
+#include <ledger.h>
+#include <new>
+
+Ledger::Ledger(int n, QObject *parent) :
+    QObject(parent),
+    accounts(0), account_count(0)
+{
+    resize(n);
+}
+
+Ledger::~Ledger()
+{
+    qFreeAligned(accounts);
+}
+
+// new[] only aligns to the cache lines from C++17 on, so the accounts are
+// allocated aligned by hand. They are trivially destructible.
+void Ledger::resize(int n)
+{
+    Q_STATIC_ASSERT(sizeof(Account) == cache_line_size);
+
+    qFreeAligned(accounts);
+
+    account_count = n;
+    accounts = static_cast<Account*>(qMallocAligned(n * sizeof(Account),cache_line_size));
+
+    for (int k = 0; k < n; k++)
+    {
+        new (&accounts[k]) Account;
+        accounts[k].units = 0;
+        accounts[k].changed = false;
+    }
+
+    return;
+}
+
+int Ledger::size(void) const
+{
+    return account_count;
+}
+
+bool Ledger::contains(int account) const
+{
+    return account >= 0 && account < account_count;
+}
+
+Money Ledger::balance(int account) const
+{
+    return Money::fromUnits(accounts[account].units.load());
+}
+
+void Ledger::setBalance(int account, Money amount)
+{
+    Account &a = accounts[account];
+
+    a.units = amount.toUnits();
+    a.changed = true;
+
+    return;
+}
+
+void Ledger::credit(int account, Money amount)
+{
+    Account &a = accounts[account];
+
+    a.units.fetch_add(amount.toUnits());
+    a.changed = true;
+
+    return;
+}
+
+bool Ledger::withdraw(int account, Money amount)
+{
+    Account &a = accounts[account];
+    qint64 units = a.units.load();
+
+    do
+    {
+        if ( units < amount.toUnits() )
+            return false;
+    }
+    while ( ! a.units.compare_exchange_weak(units,units - amount.toUnits()) );
+
+    a.changed = true;
+
+    return true;
+}
+
+// Neither balance is ever seen with the amount twice
+bool Ledger::transfer(int from, int to, Money amount)
+{
+    if ( ! withdraw(from,amount) )
+        return false;
+
+    credit(to,amount);
+
+    return true;
+}
+
+// Emits the balances that changed since the last flush. A change coming in
+// meanwhile is either reported now or marks the account for the next one.
+void Ledger::flush(void)
+{
+    for (int k = 0; k < account_count; k++)
+    {
+        Account &a = accounts[k];
+
+        if ( a.changed.load() && a.changed.exchange(false) )
+            emit balanceChanged(k,balance(k).toDouble());
+    }
+
+    return;
+}
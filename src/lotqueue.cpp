@@ -0,0 +1,248 @@
+#include <lotqueue.h>
+
+LotQueue::LotQueue(void) :
+    head(0), count(0),
+    factor(1), share_count(0),
+    method(Fifo)
+{
+}
+
+// Keeps the method and the buffer
+void LotQueue::clear(void)
+{
+    head = count = 0;
+    factor = 1;
+    share_count = 0;
+    total_cost = Money();
+
+    return;
+}
+
+// Switching to average cost merges all lots into one, O(lots) once
+void LotQueue::setMethod(CostBasis m)
+{
+    method = m;
+
+    if ( method != AverageCost || count <= 1 )
+        return;
+
+    Lot pooled = { share_count, factor, total_cost };
+
+    head = 0;
+    count = 0;
+    append(pooled);
+
+    return;
+}
+
+CostBasis LotQueue::getMethod(void) const
+{
+    return method;
+}
+
+void LotQueue::buy(int quantity, Money cost)
+{
+    if ( quantity <= 0 )
+        return;
+
+    share_count += quantity;
+    total_cost += cost;
+
+    if ( method == AverageCost && count > 0 )
+    {
+        Lot &pooled = at(0);
+        normalize(pooled);
+        pooled.quantity += quantity;
+        pooled.cost += cost;
+        return;
+    }
+
+    Lot lot = { quantity, factor, cost };
+    append(lot);
+
+    return;
+}
+
+Money LotQueue::sell(int quantity)
+{
+    Q_ASSERT(quantity <= share_count);
+    quantity = qMin(quantity,share_count);
+
+    qint64 left = quantity;
+    Money relieved;
+
+    while ( left > 0 )
+    {
+        if ( method == Lifo )
+        {
+            Lot &lot = at(count - 1);
+            relieved += relieve(lot,left);
+            if ( lot.quantity == 0 )
+                count--;
+        }
+        else
+        {
+            Lot &lot = at(0);
+            relieved += relieve(lot,left);
+            if ( lot.quantity == 0 )
+            {
+                head = (head + 1) % ring.size();
+                count--;
+            }
+        }
+    }
+
+    share_count -= quantity;
+    total_cost -= relieved;
+
+    return relieved;
+}
+
+// Without lots no quantity refers to the factor, so it starts over. A
+// factor that gets large is folded into the lots, O(lots) once in a while.
+void LotQueue::split(int ratio)
+{
+    share_count *= ratio;
+
+    if ( count == 0 )
+        factor = 1;
+    else if ( factor > max_split_factor / ratio )
+        rebase();
+
+    factor *= ratio;
+
+    return;
+}
+
+// Every lot gets the new shares whose old ones it held the last of, so
+// the lots together hold exactly shares() / ratio. A lot left without a
+// share passes its cost on to the next one, the last such lot to the one
+// before it.
+void LotQueue::consolidate(int ratio)
+{
+    Q_ASSERT(share_count % ratio == 0);
+
+    qint64 before = 0;
+    Money carried;
+    int kept = 0;
+
+    for (int k = 0; k < count; k++)
+    {
+        Lot lot = at(k);
+        normalize(lot);
+
+        qint64 quantity = (before + lot.quantity) / ratio - before / ratio;
+        before += lot.quantity;
+
+        lot.cost += carried;
+        carried = Money();
+
+        if ( quantity == 0 )
+        {
+            carried = lot.cost;
+            continue;
+        }
+
+        lot.quantity = quantity;
+        at(kept++) = lot;
+    }
+
+    if ( kept > 0 )
+        at(kept - 1).cost += carried;
+
+    count = kept;
+    share_count /= ratio;
+
+    rebase(); // the lots are all at the current factor anyway
+
+    return;
+}
+
+int LotQueue::shares(void) const
+{
+    return share_count;
+}
+
+Money LotQueue::cost(void) const
+{
+    return total_cost;
+}
+
+int LotQueue::lotCount(void) const
+{
+    return count;
+}
+
+Lot LotQueue::lot(int k) const
+{
+    Lot result = ring[(head + k) % ring.size()];
+    normalize(result);
+
+    return result;
+}
+
+Lot &LotQueue::at(int k)
+{
+    return ring[(head + k) % ring.size()];
+}
+
+// Brings the quantity to the current split factor
+void LotQueue::normalize(Lot &lot) const
+{
+    lot.quantity *= factor / lot.factor;
+    lot.factor = factor;
+
+    return;
+}
+
+// Brings every lot to the current factor and then the factor back to 1
+void LotQueue::rebase(void)
+{
+    for (int k = 0; k < count; k++)
+    {
+        Lot &lot = at(k);
+        normalize(lot);
+        lot.factor = 1;
+    }
+
+    factor = 1;
+
+    return;
+}
+
+// Takes up to 'quantity' shares out of the lot with their part of its
+// cost. What is left of the lot keeps the rounding, so the last share of
+// a lot takes exactly the rest of its cost.
+Money LotQueue::relieve(Lot &lot, qint64 &quantity)
+{
+    normalize(lot);
+
+    qint64 taken = qMin(quantity,lot.quantity);
+    Money cost = lot.cost.mulDiv(taken,lot.quantity);
+
+    lot.quantity -= taken;
+    lot.cost -= cost;
+    quantity -= taken;
+
+    return cost;
+}
+
+// Doubles the ring when it is full, unrolled so the oldest lot is first
+void LotQueue::append(const Lot &lot)
+{
+    if ( count == ring.size() )
+    {
+        QVector<Lot> grown(qMax(4,2 * ring.size()));
+
+        for (int k = 0; k < count; k++)
+            grown[k] = at(k);
+
+        ring = grown;
+        head = 0;
+    }
+
+    ring[(head + count) % ring.size()] = lot;
+    count++;
+
+    return;
+}
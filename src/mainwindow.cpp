@@ -1,17 +1,28 @@
 
 #include <mainwindow.h>
 #include <ui_mainwindow.h>
+#include <singlestock.h>
+#include <market.h>
+#include <chartexporter.h>
+#include <trace.h>
+#include <allocationcounter.h>
+#include <QDir>
+#include <QShortcut>
 #include <iostream>
 
-MoneyAvailable deposit;
-QTimer main_timer, trend_adapt_timer;
+Ledger ledger;
+MetricsRegistry metrics; // before the market, which registers its metrics
+Market market;
+QTimer main_timer, trend_adapt_timer, render_timer;
 unsigned int initial_money;
 
 unsigned int main_timer_interval;
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    main_timer_monitor(&main_timer,"stocktrader_main_timer"),
+    render_timer_monitor(&render_timer,"stocktrader_render_timer")
 {
     initial_money = default_initial_money;
 
@@ -20,28 +31,62 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->setupUi(this);
     ui->lcdMoney->hide();
     ui->initialMoney->setValue(default_initial_money);
+    ui->marketSize->setValue(default_market_size);
 
-    deposit.changeMoney(default_initial_money);
+    ledger.setBalance(player_account,Money::fromUnits(default_initial_money * money_scale));
+    market.resize(ui->marketSize->value());
 
-    QObject::connect(&deposit,SIGNAL( moneyChanged(int) ),ui->lcdMoney,SLOT(display(int)));
+    ui->marketView->setModel(&market_model);
+    ui->marketView->setItemDelegateForColumn(MarketModel::Trend,&sparkline_delegate);
+    ui->marketView->sortByColumn(MarketModel::Symbol,Qt::AscendingOrder);
+    ui->splitter->setStretchFactor(0,3);
+    ui->splitter->setStretchFactor(1,1);
+
+    QObject::connect(&ledger,SIGNAL( balanceChanged(int,double) ),this,SLOT( showBalance(int,double) ));
     QObject::connect(ui->startButton,SIGNAL( clicked() ),this,SLOT( startGame() ));
     QObject::connect(&reseed_timer,SIGNAL( timeout() ),this,SLOT( seed() ));
     QObject::connect(ui->speedBox,SIGNAL( valueChanged(int) ),this,SLOT( changeInterval(int)) );
+    QObject::connect(ui->marketSize,SIGNAL( valueChanged(int) ),this,SLOT( changeMarketSize(int)) );
+    QObject::connect(ui->fpsBox,SIGNAL( valueChanged(int) ),this,SLOT( changeFrameRate(int)) );
+    QObject::connect(ui->costBasis,SIGNAL( currentIndexChanged(int) ),this,SLOT( changeCostBasis(int)) );
+    QObject::connect(ui->buyBasketButton,SIGNAL( clicked() ),this,SLOT( buyBasket() ));
+    QObject::connect(ui->sellBasketButton,SIGNAL( clicked() ),this,SLOT( sellBasket() ));
+    QObject::connect(&main_timer,SIGNAL( timeout() ),&market,SLOT( tick() ));
+    QObject::connect(&render_timer,SIGNAL( timeout() ),this,SLOT( showPortfolio() ));
+    QObject::connect(&render_timer,SIGNAL( timeout() ),&ledger,SLOT( flush() ));
 
     // Initialize reseed timer
     reseed_timer.setSingleShot(false);
     reseed_timer.setInterval(30e3);
-    reseed_timer.start();
 
     // Initialize market change timer (trend_adapt_timer)
     trend_adapt_timer.setSingleShot(false);
     trend_adapt_timer.setInterval(100);
-    trend_adapt_timer.start();
+
+    // Both only run while the game is running, see setBackgroundTimers()
 
     // Set up main timer (controlling the update frequency of the prices)
     main_timer.setSingleShot(false);
     // Set timer interval to 400 / 8 = 50 ms
     ui->speedBox->setValue(8);
+
+    // Views are drawn at most at the frame rate, no matter how fast the
+    // prices are simulated, and only if there were new ticks.
+    render_timer.setSingleShot(false);
+    ui->fpsBox->setValue(default_frame_rate);
+    changeFrameRate(default_frame_rate);
+
+    if ( metrics_server.listen(MetricsServer::defaultPath()) )
+        std::cout << "Metrics are served on " << metrics_server.socketPath().toStdString() << "\n";
+
+#ifdef STOCKTRADER_ALLOC_COUNT
+    new AllocationMonitor(&render_timer,this);
+#endif
+
+#ifdef STOCKTRADER_TRACE
+    QShortcut *trace_shortcut = new QShortcut(QKeySequence(Qt::Key_F12),this);
+    QObject::connect(trace_shortcut,SIGNAL( activated() ),this,SLOT( dumpTrace() ));
+#endif
 }
 
 void MainWindow::seed(void)
@@ -54,15 +99,22 @@ void MainWindow::seed(void)
 
 void MainWindow::startGame(void)
 {
-    deposit.changeMoney(initial_money = ui->initialMoney->value());
+    initial_money = ui->initialMoney->value();
+    ledger.setBalance(player_account,Money::fromUnits(initial_money * money_scale));
+    ledger.flush();
     ui->initialMoney->hide();
     ui->lcdMoney->show();
+    ui->marketSize->setEnabled(false);
 
     ui->startButton->setText("Pause");
     QObject::disconnect(ui->startButton,SIGNAL( clicked() ),this,SLOT( startGame() ));
     QObject::connect(ui->startButton,SIGNAL( clicked() ),this,SLOT( pauseGame() ));
 
     main_timer.start();
+    render_timer.start();
+    main_timer_monitor.restart();
+    render_timer_monitor.restart();
+    setBackgroundTimers(true);
 
     return;
 }
@@ -70,6 +122,10 @@ void MainWindow::startGame(void)
 void MainWindow::pauseGame(void)
 {
     main_timer.stop();
+    setBackgroundTimers(false);
+
+    // Let one more frame draw the last ticks
+    QTimer::singleShot(render_timer.interval(),this,SLOT( stopRendering() ));
 
     ui->startButton->setText("Continue");
 
@@ -82,6 +138,10 @@ void MainWindow::pauseGame(void)
 void MainWindow::continueGame(void)
 {
     main_timer.start();
+    render_timer.start();
+    main_timer_monitor.restart();
+    render_timer_monitor.restart();
+    setBackgroundTimers(true);
     ui->startButton->setText("Pause");
     QObject::disconnect(ui->startButton,SIGNAL( clicked() ),this,SLOT( continueGame() ));
     QObject::connect(ui->startButton,SIGNAL( clicked() ),this,SLOT( pauseGame() ));
@@ -94,6 +154,117 @@ void MainWindow::changeInterval(int interval_divisor)
     main_timer.setInterval(main_timer_interval);
 }
 
+// The trends and the random seed only matter while prices are generated,
+// so a paused game does not wake up at all.
+void MainWindow::setBackgroundTimers(bool running)
+{
+    if ( running )
+    {
+        trend_adapt_timer.start();
+        reseed_timer.start();
+    }
+    else
+    {
+        trend_adapt_timer.stop();
+        reseed_timer.stop();
+    }
+
+    return;
+}
+
+void MainWindow::stopRendering(void)
+{
+    if ( ! main_timer.isActive() )
+        render_timer.stop();
+
+    return;
+}
+
+// Writes the recorded trace spans into trace-<time>.json (F12, trace builds only)
+void MainWindow::dumpTrace(void)
+{
+#ifdef STOCKTRADER_TRACE
+    QString file_name = "trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".json";
+
+    if ( Trace::dump(file_name) )
+        std::cout << "Trace written to " << file_name.toStdString() << "\n";
+#endif
+
+    return;
+}
+
+// The balances come once per frame, see Ledger::flush()
+void MainWindow::showBalance(int account, double balance)
+{
+    if ( account == player_account )
+        ui->lcdMoney->display(balance);
+
+    return;
+}
+
+// The valuation and the risk of the last tick in the status bar
+void MainWindow::showPortfolio(void)
+{
+    const PortfolioSample &s = market.getPortfolio().sample(market.lastPosition());
+    const RiskBank &risk = market.getRisk();
+    RiskSnapshot r = risk.snapshot(risk.portfolioSeries());
+
+    ui->statusBar->showMessage(QString("Equity: %1   Unrealized P&L: %2   Realized P&L: %3   VaR %4%: %5   Max. drawdown: %6 %   Market index: %7")
+                               .arg(s.equity.toDouble(),0,'f',2)
+                               .arg(s.unrealized.toDouble(),0,'f',2)
+                               .arg(s.realized.toDouble(),0,'f',2)
+                               .arg(100 * risk.getConfidence())
+                               .arg(r.value_at_risk * s.equity.toDouble(),0,'f',2)
+                               .arg(100 * r.max_drawdown,0,'f',1)
+                               .arg(market.getBaskets().index(market_basket),0,'f',2));
+
+    return;
+}
+
+void MainWindow::changeFrameRate(int fps)
+{
+    render_timer.setInterval(1000 / fps);
+
+    return;
+}
+
+// The order of the box is the one of CostBasis
+void MainWindow::changeCostBasis(int method)
+{
+    market.setCostBasis(CostBasis(method));
+
+    return;
+}
+
+// One share of every stock, filled at the next tick or not at all
+void MainWindow::buyBasket(void)
+{
+    if ( ! main_timer.isActive() )
+        return;
+
+    market.submitBasketOrder(market_basket,Order::Buy,1);
+
+    return;
+}
+
+void MainWindow::sellBasket(void)
+{
+    if ( ! main_timer.isActive() )
+        return;
+
+    market.submitBasketOrder(market_basket,Order::Sell,1);
+
+    return;
+}
+
+// Only possible before the game has been started
+void MainWindow::changeMarketSize(int tickers)
+{
+    market.resize(tickers);
+
+    return;
+}
+
 MainWindow::~MainWindow()
 {
     afterGameFinished();
@@ -103,13 +274,33 @@ MainWindow::~MainWindow()
 
 void MainWindow::afterGameFinished(void)
 {
-    if ( deposit.getMoney() - initial_money > 0 )
-        std::cout << "Congratulations! You earned " << deposit.getMoney() - initial_money << " units of liquid capital!\n";
-    else if ( deposit.getMoney() - initial_money == 0)
+    Money earned = ledger.balance(player_account) - Money::fromUnits(initial_money * money_scale);
+
+    if ( earned > Money() )
+        std::cout << "Congratulations! You earned " << earned.toDouble() << " units of liquid capital!\n";
+    else if ( earned == Money() )
     {
     }
     else
-        std::cout << "Congratulations! You lost " << ((-1) * (deposit.getMoney() - initial_money)) << " units of liquid capital!\n";
+        std::cout << "Congratulations! You lost " << (-earned).toDouble() << " units of liquid capital!\n";
+
+    if ( ui->exportBox->isChecked() )
+        exportCharts();
+
+    return;
+}
+
+// Writes the price history of every stock of the market as PNG into ./charts
+void MainWindow::exportCharts(void)
+{
+    ChartExporter exporter;
+
+    for (int t = 0; t < market.size(); t++)
+        exporter.addChart(market.name(t),market.priceHistory(t));
+
+    int written = exporter.exportCharts(QDir::current().filePath("charts"));
+
+    std::cout << "Exported " << written << " charts.\n";
 
     return;
 }
\ No newline at end of file
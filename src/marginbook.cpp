@@ -0,0 +1,411 @@
+#include <marginbook.h>
+#include <trace.h>
+#include <cmath>
+
+// Solves collateral + quantity * (price - entry) = maintenance_margin * |quantity| * price
+// for the price, rounded so that reaching the returned price is crossing it
+static qint64 liquidationPrice(const MarginPosition &p)
+{
+    double entry = p.entry.toUnits();
+    double collateral = p.collateral.toUnits();
+
+    if ( p.quantity > 0 )
+        return qint64(std::floor((p.quantity * entry - collateral) / (p.quantity * (1 - maintenance_margin))));
+
+    double shares = -p.quantity;
+
+    return qint64(std::ceil((collateral + shares * entry) / (shares * (1 + maintenance_margin))));
+}
+
+// Long positions fire at a price at or below theirs, short ones at or above
+static qint64 heapKey(const MarginPosition &p)
+{
+    return p.quantity > 0 ? p.liquidation : -p.liquidation;
+}
+
+static Money positionEquity(const MarginPosition &p, Money price)
+{
+    return p.collateral + qint64(p.quantity) * (price - p.entry);
+}
+
+MarginBook::MarginBook(int n, int accounts) :
+    tickers(0), sequence(0),
+    positions(margin_pool_size), free_positions(-1), heaps(margin_pool_size),
+    events(margin_pool_size), event_count(0)
+{
+    resize(n,accounts);
+}
+
+void MarginBook::resize(int n, int accounts)
+{
+    tickers = n;
+    longs.fill(-1,n);
+    shorts.fill(-1,n);
+    account_positions.fill(-1,accounts);
+    ticker_positions.fill(-1,n);
+
+    free_positions = -1;
+    for (int k = margin_pool_size - 1; k >= 0; k--)
+    {
+        positions[k].id = 0;
+        positions[k].next = free_positions;
+        free_positions = k;
+    }
+
+    event_count = 0;
+
+    return;
+}
+
+qint64 MarginBook::open(int account, int t, int quantity, Money price, Money collateral)
+{
+    if ( t < 0 || t >= tickers || account < 0 || account >= account_positions.size() )
+        return 0;
+    if ( quantity == 0 || price <= Money() || free_positions < 0 )
+        return 0;
+    if ( collateral < Money::fromDouble(qAbs(quantity) * price.toDouble() * initial_margin) )
+        return 0;
+
+    int k = free_positions;
+    MarginPosition &p = positions[k];
+    free_positions = p.next;
+
+    p.id = (++sequence << margin_index_bits) | k;
+    p.account = account;
+    p.ticker = t;
+    p.quantity = quantity;
+    p.entry = price;
+    p.collateral = collateral;
+    p.liquidation = liquidationPrice(p);
+
+    int &first = account_positions[account];
+
+    if ( first < 0 )
+    {
+        p.prev = p.next = k;
+        first = k;
+    }
+    else
+    {
+        p.next = first;
+        p.prev = positions[first].prev;
+        positions[p.prev].next = k;
+        positions[p.next].prev = k;
+    }
+
+    int &ticker_first = ticker_positions[t];
+
+    if ( ticker_first < 0 )
+    {
+        p.ticker_prev = p.ticker_next = k;
+        ticker_first = k;
+    }
+    else
+    {
+        p.ticker_next = ticker_first;
+        p.ticker_prev = positions[ticker_first].ticker_prev;
+        positions[p.ticker_prev].ticker_next = k;
+        positions[p.ticker_next].ticker_prev = k;
+    }
+
+    push(k);
+
+    return p.id;
+}
+
+bool MarginBook::close(qint64 id, Money price)
+{
+    int k = find(id);
+
+    if ( k < 0 )
+        return false;
+
+    settle(k,price,MarginEvent::Closed);
+
+    return true;
+}
+
+void MarginBook::closeAll(int t, Money price, int account)
+{
+    if ( t < 0 || t >= tickers || ticker_positions[t] < 0 )
+        return;
+
+    // Settling a position keeps the ring of the others, the last one is
+    // taken before it may go
+    int k = ticker_positions[t];
+    int last = positions[k].ticker_prev;
+
+    for (;;)
+    {
+        int next = positions[k].ticker_next;
+        bool done = k == last;
+
+        if ( account < 0 || positions[k].account == account )
+            settle(k,price,MarginEvent::Closed);
+        if ( done )
+            break;
+        k = next;
+    }
+
+    return;
+}
+
+void MarginBook::split(int t, int ratio)
+{
+    int first = ticker_positions[t];
+
+    if ( first < 0 )
+        return;
+
+    int k = first;
+    do
+    {
+        MarginPosition &p = positions[k];
+
+        p.quantity *= ratio;
+        p.entry = p.entry / ratio;
+        p.liquidation = liquidationPrice(p);
+        k = p.ticker_next;
+    }
+    while ( k != first );
+
+    rebuild(t);
+
+    return;
+}
+
+// The shares that don't make up a new one are settled at 'price' into the
+// collateral, so the equity of a position stays what it was
+void MarginBook::consolidate(int t, int ratio, Money price)
+{
+    if ( ticker_positions[t] < 0 )
+        return;
+
+    int k = ticker_positions[t];
+    int last = positions[k].ticker_prev;
+
+    for (;;)
+    {
+        int next = positions[k].ticker_next;
+        bool done = k == last;
+
+        if ( qAbs(positions[k].quantity) < ratio )
+            settle(k,price,MarginEvent::Closed);
+        if ( done )
+            break;
+        k = next;
+    }
+
+    int first = ticker_positions[t];
+
+    if ( first < 0 )
+        return;
+
+    k = first;
+    do
+    {
+        MarginPosition &p = positions[k];
+        int quantity = p.quantity / ratio;
+
+        p.collateral += qint64(p.quantity - quantity * ratio) * (price - p.entry);
+        p.quantity = quantity;
+        p.entry = ratio * p.entry;
+        p.liquidation = liquidationPrice(p);
+        k = p.ticker_next;
+    }
+    while ( k != first );
+
+    rebuild(t);
+
+    return;
+}
+
+void MarginBook::evaluate(const double *prices)
+{
+    TRACE_SPAN("MarginBook::evaluate");
+
+    for (int t = 0; t < tickers; t++)
+    {
+        if ( prices[t] <= 0 )
+            continue;
+
+        Money price = Money::fromDouble(prices[t]);
+
+        while ( longs[t] >= 0 && heaps.key(longs[t]) >= price.toUnits() )
+            settle(longs[t],price,MarginEvent::Liquidated);
+        while ( shorts[t] >= 0 && -heaps.key(shorts[t]) <= price.toUnits() )
+            settle(shorts[t],price,MarginEvent::Liquidated);
+    }
+
+    return;
+}
+
+const MarginPosition *MarginBook::position(qint64 id) const
+{
+    int k = find(id);
+
+    return k < 0 ? 0 : &positions[k];
+}
+
+// The positions of a delisted ticker were closed, the others are valued at
+// the given prices
+Money MarginBook::equity(int account, const double *prices) const
+{
+    int first = account_positions[account];
+    Money total;
+
+    if ( first < 0 )
+        return total;
+
+    int k = first;
+    do
+    {
+        const MarginPosition &p = positions[k];
+        Money price = prices[p.ticker] > 0 ? Money::fromDouble(prices[p.ticker]) : p.entry;
+
+        total += positionEquity(p,price);
+        k = p.next;
+    }
+    while ( k != first );
+
+    return total;
+}
+
+int MarginBook::quantity(int account, int t) const
+{
+    int first = account_positions[account];
+    int total = 0;
+
+    if ( first < 0 )
+        return total;
+
+    int k = first;
+    do
+    {
+        if ( positions[k].ticker == t )
+            total += positions[k].quantity;
+        k = positions[k].next;
+    }
+    while ( k != first );
+
+    return total;
+}
+
+int MarginBook::eventCount(void) const
+{
+    return event_count;
+}
+
+const MarginEvent &MarginBook::event(int k) const
+{
+    return events[k];
+}
+
+void MarginBook::clearEvents(void)
+{
+    event_count = 0;
+
+    return;
+}
+
+int MarginBook::find(qint64 id) const
+{
+    int k = id & ((1 << margin_index_bits) - 1);
+
+    if ( id <= 0 || k >= margin_pool_size || positions[k].id != id )
+        return -1;
+
+    return k;
+}
+
+void MarginBook::push(int k)
+{
+    const MarginPosition &p = positions[k];
+
+    if ( p.quantity > 0 )
+        longs[p.ticker] = heaps.push(longs[p.ticker],k,heapKey(p));
+    else
+        shorts[p.ticker] = heaps.push(shorts[p.ticker],k,heapKey(p));
+
+    return;
+}
+
+// After the liquidation prices of a ticker changed, which may not keep
+// their order because of the rounding
+void MarginBook::rebuild(int t)
+{
+    int first = ticker_positions[t];
+
+    longs[t] = shorts[t] = -1;
+
+    if ( first < 0 )
+        return;
+
+    int k = first;
+    do
+    {
+        push(k);
+        k = positions[k].ticker_next;
+    }
+    while ( k != first );
+
+    return;
+}
+
+void MarginBook::settle(int k, Money price, MarginEvent::Reason reason)
+{
+    MarginPosition &p = positions[k];
+    MarginEvent &e = events[event_count++];
+
+    e.position = p.id;
+    e.account = p.account;
+    e.ticker = p.ticker;
+    e.reason = reason;
+    e.quantity = p.quantity;
+    e.price = price;
+    e.payout = qMax(Money(),positionEquity(p,price));
+
+    if ( p.quantity > 0 )
+        longs[p.ticker] = heaps.remove(longs[p.ticker],k);
+    else
+        shorts[p.ticker] = heaps.remove(shorts[p.ticker],k);
+
+    unlink(k);
+
+    p.id = 0;
+    p.next = free_positions;
+    free_positions = k;
+
+    return;
+}
+
+// Takes the position out of the rings of its account and its ticker
+void MarginBook::unlink(int k)
+{
+    MarginPosition &p = positions[k];
+    int &first = account_positions[p.account];
+
+    if ( p.next == k )
+        first = -1;
+    else
+    {
+        positions[p.prev].next = p.next;
+        positions[p.next].prev = p.prev;
+        if ( first == k )
+            first = p.next;
+    }
+
+    int &ticker_first = ticker_positions[p.ticker];
+
+    if ( p.ticker_next == k )
+        ticker_first = -1;
+    else
+    {
+        positions[p.ticker_prev].ticker_next = p.ticker_next;
+        positions[p.ticker_next].ticker_prev = p.ticker_prev;
+        if ( ticker_first == k )
+            ticker_first = p.ticker_next;
+    }
+
+    return;
+}
@@ -0,0 +1,858 @@
+#include <market.h>
+#include <ledger.h>
+#include <trace.h>
+#include <allocationcounter.h>
+
+Market::Market(QObject *parent) :
+    QObject(parent),
+    history_length(default_history_length),
+    position(0), tick_count(0),
+    cost_basis(Fifo),
+    last_tick_time(0)
+{
+    tick_time = metrics.histogram("stocktrader_tick_seconds","Duration of one simulation step of the whole market");
+}
+
+Market::~Market()
+{
+    qDeleteAll(companies);
+}
+
+// Only meant to be called before the game starts
+void Market::resize(int n, int length)
+{
+    history_length = length;
+
+    while (companies.size() > n)
+        delete companies.takeLast();
+    while (companies.size() < n)
+        companies.append(new Company);
+
+    names.resize(n);
+    prices.fill(0,n);
+    opens.fill(0,n);
+    price_history.fill(0,n * history_length);
+    age.fill(0,n);
+    indicators.resize(n);
+    risk.resize(n);
+    position = tick_count = 0;
+
+    // About a dividend and a listing per ticker, and what a tick breaches
+    actions.clear(4 * n);
+    listings.fill(0,n);
+    listed.fill(false,n);
+    floors.fill(0,n);
+    ceilings.fill(0,n);
+    adjustments.fill(1,n);
+    adjusted.clear();
+    adjusted.reserve(n);
+    applied.clear();
+    applied.reserve(4 * n);
+    action_ticks.fill(-1,n);
+
+    matching.resize(n);
+    triggers.resize(n);
+    margin.resize(n,ledger.size());
+    portfolio.resize(n,history_length);
+    reserved_cash = Money();
+    reserved_shares.fill(0,n);
+
+    for (int t = 0; t < n; t++)
+        list(t);
+
+    QVector<BasketLeg> everything(n);
+    for (int t = 0; t < n; t++)
+    {
+        everything[t].ticker = t;
+        everything[t].shares = 1;
+    }
+
+    baskets.resize(n);
+    baskets.define(everything);
+    basket_orders.clear();
+    basket_order_legs.clear();
+
+    emit resized();
+
+    return;
+}
+
+int Market::size(void) const
+{
+    return companies.size();
+}
+
+// Places a new company on the ticker. It trades from the next tick on and
+// pays its first dividend at a random tick of the first interval.
+void Market::list(int t)
+{
+    Company *c = companies[t];
+
+    c->initCompany(100);
+    c->setCostBasis(cost_basis);
+    names[t] = newCompanyName();
+    prices[t] = opens[t] = 0;
+    age[t] = 0;
+
+    listed[t] = true;
+    listings[t]++;
+    floors[t] = reverse_split_level * c->ymax;
+    ceilings[t] = split_level * c->ymax;
+
+    double *row = price_history.data() + t * history_length;
+    for (int k = 0; k < history_length; k++)
+        row[k] = 0;
+
+    indicators.reset(t);
+    risk.reset(t);
+
+    actions.schedule(tick_count + 1 + qrand() % dividend_interval,t,CorporateAction::Dividend,listings[t]);
+
+    return;
+}
+
+// The price left the band of the ticker. Splits and delistings are due at
+// once, a reverse split is announced and only the bankruptcy level is
+// checked until it takes place.
+void Market::breach(int t)
+{
+    ALLOCATION_PHASE(phase_event);
+
+    double bankruptcy = bankruptcy_level * companies[t]->ymax;
+
+    if ( prices[t] <= bankruptcy )
+        actions.schedule(tick_count,t,CorporateAction::Delisting,listings[t]);
+    else if ( prices[t] <= floors[t] )
+    {
+        actions.schedule(tick_count + reverse_split_notice,t,CorporateAction::ReverseSplit,listings[t],split_ratio);
+        floors[t] = bankruptcy;
+    }
+    else
+        actions.schedule(tick_count,t,CorporateAction::Split,listings[t],split_ratio);
+
+    return;
+}
+
+// Applies all actions that are due, in the order they were scheduled in.
+// The ones meant for an earlier listing of their ticker are dropped.
+void Market::applyActions(void)
+{
+    if ( ! actions.due(tick_count) )
+        return;
+
+    TRACE_SPAN("Market::applyActions");
+    ALLOCATION_PHASE(phase_event);
+
+    while ( actions.due(tick_count) )
+    {
+        CorporateAction action = actions.take();
+
+        if ( action.listing != listings[action.ticker] )
+            continue;
+
+        action_ticks[action.ticker] = tick_count;
+
+        switch ( action.type )
+        {
+        case CorporateAction::Split:
+            split(action.ticker,action.ratio);
+            break;
+        case CorporateAction::ReverseSplit:
+            consolidate(action.ticker,action.ratio);
+            break;
+        case CorporateAction::Dividend:
+            payDividend(action.ticker);
+            break;
+        case CorporateAction::Delisting:
+            delist(action.ticker);
+            break;
+        case CorporateAction::Listing:
+            list(action.ticker);
+            break;
+        }
+
+        applied.append(action);
+    }
+
+    adjustHistories();
+
+    return;
+}
+
+void Market::split(int t, int ratio)
+{
+    Company *c = companies[t];
+
+    c->split(ratio);
+    indicators.scale(t,1.0 / ratio);
+    risk.scale(t,1.0 / ratio);
+    matching.cancelAll(t); // the limits are meant for the old price
+    triggers.split(t,ratio); // while triggers follow the holdings
+    portfolio.split(t,ratio);
+    baskets.split(t,ratio);
+    margin.split(t,ratio);
+
+    prices[t] = c->getPrice().toDouble();
+    if ( adjustments[t] == 1 )
+        adjusted.append(t);
+    adjustments[t] /= ratio;
+
+    return;
+}
+
+// The shares of the depot that don't make up a new share are sold at the
+// price of the tick first
+void Market::consolidate(int t, int ratio)
+{
+    Company *c = companies[t];
+    Money price = c->getPrice();
+    int odd = c->getShares() % ratio;
+
+    matching.cancelAll(t);
+    triggers.consolidate(t,ratio);
+    margin.consolidate(t,ratio,price);
+
+    if ( odd > 0 )
+    {
+        Money cost = c->sell(odd);
+        portfolio.fill(t,-odd,price,cost);
+        ledger.credit(player_account,odd * price);
+    }
+
+    c->consolidate(ratio);
+    indicators.scale(t,ratio);
+    risk.scale(t,ratio);
+    portfolio.consolidate(t,ratio);
+    baskets.consolidate(t,ratio);
+
+    prices[t] = c->getPrice().toDouble();
+    floors[t] = reverse_split_level * c->ymax;
+    if ( adjustments[t] == 1 )
+        adjusted.append(t);
+    adjustments[t] *= ratio;
+
+    return;
+}
+
+// Pays dividend_yield of the price per share of the depot, the price drops
+// by as much, and schedules the next one
+void Market::payDividend(int t)
+{
+    Company *c = companies[t];
+    Money amount = Money::fromDouble(c->getPrice().toDouble() * dividend_yield);
+
+    if ( amount > Money() )
+    {
+        int shares = c->getShares();
+
+        c->exDividend(amount);
+        portfolio.dividend(t,amount);
+        if ( shares > 0 )
+            ledger.credit(player_account,shares * amount);
+
+        prices[t] = c->getPrice().toDouble();
+        price_history[t * history_length + position] = prices[t];
+    }
+
+    actions.schedule(tick_count + dividend_interval,t,CorporateAction::Dividend,listings[t]);
+
+    return;
+}
+
+// The company went bankrupt, a new one is listed after relist_delay ticks
+void Market::delist(int t)
+{
+    companies[t]->delist();
+    prices[t] = 0;
+    price_history[t * history_length + position] = 0;
+
+    listed[t] = false;
+    listings[t]++;
+
+    matching.cancelAll(t);
+    triggers.cancelAll(t);
+    margin.closeAll(t,Money()); // short positions win everything
+    portfolio.writeOff(t);
+
+    actions.schedule(tick_count + relist_delay,t,CorporateAction::Listing,listings[t]);
+
+    return;
+}
+
+// Rescales the history rows of the tickers split in this tick at once, so
+// the charts show adjusted prices. The new price of the tick is exact.
+void Market::adjustHistories(void)
+{
+    for (int k = 0; k < adjusted.size(); k++)
+    {
+        int t = adjusted[k];
+        double f = adjustments[t];
+        double *row = price_history.data() + t * history_length;
+
+        for (int j = 0; j < history_length; j++)
+            row[j] *= f;
+
+        row[position] = prices[t];
+        opens[t] *= f;
+        adjustments[t] = 1;
+    }
+
+    adjusted.clear();
+
+    return;
+}
+
+void Market::announceActions(void)
+{
+    for (int k = 0; k < applied.size(); k++)
+    {
+        const CorporateAction &action = applied[k];
+
+        switch ( action.type )
+        {
+        case CorporateAction::Split:
+        case CorporateAction::ReverseSplit:
+            emit splitted(action.ticker);
+            break;
+        case CorporateAction::Delisting:
+            emit bankrupt(action.ticker);
+            break;
+        case CorporateAction::Listing:
+            emit relisted(action.ticker);
+            break;
+        case CorporateAction::Dividend:
+            break; // the ledger tells about the money
+        }
+    }
+
+    applied.clear();
+
+    return;
+}
+
+void Market::tick(void)
+{
+    TRACE_SPAN("Market::tick");
+    ALLOCATION_PHASE(phase_price_update); // a steady-state tick doesn't allocate
+
+    qint64 begin = MetricsRegistry::now();
+    int n = companies.size();
+
+    for (int t = 0; t < n; t++)
+    {
+        if ( ! listed[t] )
+            continue;
+
+        prices[t] = companies[t]->updatePrice();
+        price_history[t * history_length + position] = prices[t];
+        if ( age[t]++ == 0 )
+            opens[t] = prices[t];
+
+        if ( prices[t] <= floors[t] || prices[t] >= ceilings[t] )
+            breach(t);
+    }
+
+    applyActions();
+
+    margin.evaluate(prices.constData());
+    settleMargin();
+
+    indicators.update(prices.constData());
+
+    triggers.evaluate(prices.constData());
+    fireTriggers();
+
+    matching.match(prices.constData());
+    settleOrders();
+    executeBasketOrders();
+
+    portfolio.mark(prices.constData());
+    portfolio.record(position,ledger.balance(player_account) + margin.equity(player_account,prices.constData()));
+    risk.update(prices.constData(),portfolio.sample(position).equity.toDouble());
+    baskets.update(prices.constData());
+
+    position = (position + 1) % history_length;
+    tick_count++;
+
+    last_tick_time = MetricsRegistry::now();
+    tick_time->record(last_tick_time - begin);
+
+    emit ticked();
+    announceActions();
+
+    return;
+}
+
+qint64 Market::submitOrder(int t, int account, Order::Side side, Order::Type type, int quantity, double price)
+{
+    if ( t < 0 || t >= companies.size() || ! isListed(t) )
+        return 0;
+
+    int limit = price > 0 ? MatchingEngine::toTicks(price) : 0;
+    Money cost = quantity * MatchingEngine::toMoney(limit);
+
+    // The player can't spend more than the balance or sell shares that
+    // aren't in the depot, so buy orders of the player need a limit.
+    if ( account == player_account )
+    {
+        if ( side == Order::Buy && ( limit <= 0 || cost > availableCash() ) )
+            return 0;
+        if ( side == Order::Sell && quantity > availableShares(t) )
+            return 0;
+    }
+
+    // The other accounts have no reservations, the ledger holds back the
+    // cost of their buy orders right away, so they need a limit as well
+    bool escrow = account != player_account && ledger.contains(account) && side == Order::Buy;
+
+    if ( escrow && ( limit <= 0 || ! ledger.withdraw(account,cost) ) )
+        return 0;
+
+    qint64 id = matching.submit(account,t,side,type,quantity,limit);
+
+    if ( ! id && escrow )
+        ledger.credit(account,cost);
+
+    if ( id && account == player_account )
+    {
+        if ( side == Order::Buy )
+            reserved_cash += cost;
+        else
+            reserved_shares[t] += quantity;
+    }
+
+    return id;
+}
+
+// Rejected if a leg isn't listed or the player lacks the cash or shares
+// for all legs together at the current prices plus the protection
+bool Market::submitBasketOrder(int b, Order::Side side, int units)
+{
+    if ( b < 0 || b >= baskets.size() || units <= 0 )
+        return false;
+
+    Money total;
+
+    for (int k = 0; k < baskets.legCount(b); k++)
+    {
+        const BasketLeg &leg = baskets.leg(b,k);
+        int quantity = units * leg.shares;
+
+        if ( ! isListed(leg.ticker) || prices[leg.ticker] <= 0 )
+            return false;
+        if ( side == Order::Sell && quantity > availableShares(leg.ticker) )
+            return false;
+
+        total += quantity * Money::fromDouble(prices[leg.ticker]);
+    }
+
+    double protection = side == Order::Buy ? market_order_protection : -market_order_protection;
+    Money limit = Money::fromDouble(total.toDouble() * (1 + protection));
+
+    if ( side == Order::Buy && limit > availableCash() )
+        return false;
+
+    BasketOrder order = { b, side, limit, basket_order_legs.size(), baskets.legCount(b) };
+
+    for (int k = 0; k < order.count; k++)
+    {
+        BasketLeg leg = baskets.leg(b,k);
+        leg.shares *= units;
+        basket_order_legs.append(leg);
+
+        if ( side == Order::Sell )
+            reserved_shares[leg.ticker] += leg.shares;
+    }
+
+    if ( side == Order::Buy )
+        reserved_cash += limit;
+
+    basket_orders.append(order);
+
+    return true;
+}
+
+qint64 Market::openPosition(int t, int account, int quantity)
+{
+    if ( t < 0 || t >= companies.size() || ! isListed(t) || prices[t] <= 0 || quantity == 0 )
+        return 0;
+    if ( ! ledger.contains(account) )
+        return 0;
+
+    Money price = Money::fromDouble(prices[t]);
+    Money collateral = Money::fromDouble(qAbs(quantity) * price.toDouble() * initial_margin);
+
+    // The cash of open buy orders of the player isn't free
+    if ( account == player_account && collateral > availableCash() )
+        return 0;
+    if ( ! ledger.withdraw(account,collateral) )
+        return 0;
+
+    qint64 id = margin.open(account,t,quantity,price,collateral);
+
+    if ( ! id )
+        ledger.credit(account,collateral);
+
+    return id;
+}
+
+bool Market::closePosition(qint64 id)
+{
+    const MarginPosition *p = margin.position(id);
+
+    if ( ! p || prices[p->ticker] <= 0 )
+        return false;
+
+    margin.close(id,Money::fromDouble(prices[p->ticker]));
+    settleMargin();
+
+    return true;
+}
+
+void Market::closePositions(int t, int account)
+{
+    if ( prices[t] <= 0 )
+        return;
+
+    margin.closeAll(t,Money::fromDouble(prices[t]),account);
+    settleMargin();
+
+    return;
+}
+
+const MarginBook &Market::getMargin(void) const
+{
+    return margin;
+}
+
+bool Market::cancelOrder(qint64 id)
+{
+    return matching.cancel(id);
+}
+
+const MatchingEngine &Market::getMatchingEngine(void) const
+{
+    return matching;
+}
+
+// Risk of every ticker and of the equity of the player, safe to read from
+// any thread
+const RiskBank &Market::getRisk(void) const
+{
+    return risk;
+}
+
+// The index of every basket follows the prices of the last tick
+const BasketBook &Market::getBaskets(void) const
+{
+    return baskets;
+}
+
+// Valued at the end of every tick, the samples are at the ring positions
+// of the price history
+const Portfolio &Market::getPortfolio(void) const
+{
+    return portfolio;
+}
+
+// Triggers of the player can't be placed on more shares than the depot
+// holds. They don't reserve them, so several may cover the same shares.
+qint64 Market::placeTrigger(int t, int account, Trigger::Kind kind, int quantity, double price)
+{
+    if ( t < 0 || t >= companies.size() || ! isListed(t) || prices[t] <= 0 )
+        return 0;
+
+    if ( account == player_account && quantity > companies[t]->getShares() )
+        return 0;
+
+    return triggers.place(account,t,kind,quantity,MatchingEngine::toTicks(price),MatchingEngine::toTicks(prices[t]));
+}
+
+bool Market::cancelTrigger(qint64 id)
+{
+    return triggers.cancel(id);
+}
+
+void Market::cancelTriggers(int t, int account)
+{
+    triggers.cancelAll(t,account);
+
+    return;
+}
+
+Money Market::availableCash(void) const
+{
+    return ledger.balance(player_account) - reserved_cash;
+}
+
+int Market::availableShares(int t) const
+{
+    return companies[t]->getShares() - reserved_shares[t];
+}
+
+// Takes effect with the next sale
+void Market::setCostBasis(CostBasis method)
+{
+    cost_basis = method;
+
+    for (int t = 0; t < companies.size(); t++)
+        companies[t]->setCostBasis(method);
+
+    return;
+}
+
+// Turns the fired triggers into market sell orders, protected like the
+// ones of the player. Shares sold in the meantime are left out.
+void Market::fireTriggers(void)
+{
+    for (int k = 0; k < triggers.eventCount(); k++)
+    {
+        const TriggerEvent &e = triggers.event(k);
+        int quantity = e.quantity;
+
+        if ( e.account == player_account )
+            quantity = qMin(quantity,availableShares(e.ticker));
+
+        if ( quantity > 0 )
+            submitOrder(e.ticker,e.account,Order::Sell,Order::Market,quantity,MatchingEngine::fromTicks(e.price) * (1 - market_order_protection));
+    }
+
+    triggers.clearEvents();
+
+    return;
+}
+
+// Books the fills of the player's orders into the depots and the ledger
+// and releases what was reserved for them. The other accounts of the
+// ledger have no depots yet, only their cash is booked: sales are
+// credited, buys get back what their limit held back beyond the fill.
+void Market::settleOrders(void)
+{
+    for (int k = 0; k < matching.eventCount(); k++)
+    {
+        const OrderEvent &e = matching.event(k);
+        Money volume = e.filled * MatchingEngine::toMoney(e.price);
+
+        if ( e.account != player_account )
+        {
+            if ( ! ledger.contains(e.account) )
+                continue;
+            if ( e.side == Order::Buy )
+                ledger.credit(e.account,(e.filled + e.cancelled) * MatchingEngine::toMoney(e.limit) - volume);
+            else if ( e.filled > 0 )
+                ledger.credit(e.account,volume);
+            continue;
+        }
+
+        ALLOCATION_PHASE(phase_event);
+        Company *c = companies[e.ticker];
+
+        if ( e.side == Order::Buy )
+        {
+            reserved_cash -= (e.filled + e.cancelled) * MatchingEngine::toMoney(e.limit);
+            if ( e.filled > 0 )
+            {
+                c->buy(e.filled,MatchingEngine::toMoney(e.price));
+                portfolio.fill(e.ticker,e.filled,MatchingEngine::toMoney(e.price),volume);
+                ledger.credit(player_account,-volume);
+            }
+        }
+        else
+        {
+            reserved_shares[e.ticker] -= e.filled + e.cancelled;
+            if ( e.filled > 0 )
+            {
+                Money cost = c->sell(e.filled);
+                portfolio.fill(e.ticker,-e.filled,MatchingEngine::toMoney(e.price),cost);
+                ledger.credit(player_account,volume);
+            }
+        }
+
+        if ( e.filled > 0 )
+            emit depotChanged(e.ticker);
+    }
+
+    matching.clearEvents();
+
+    return;
+}
+
+// Fills all legs of a basket order at the prices of the tick, or none if
+// a leg isn't listed, had a corporate action in this tick or the total is
+// past the limit. The cash is booked once for the whole order.
+void Market::executeBasketOrders(void)
+{
+    if ( basket_orders.isEmpty() )
+        return;
+
+    ALLOCATION_PHASE(phase_event);
+
+    for (int k = 0; k < basket_orders.size(); k++)
+    {
+        const BasketOrder &order = basket_orders[k];
+        const BasketLeg *legs = basket_order_legs.constData() + order.first;
+        bool buy = order.side == Order::Buy;
+        bool valid = true;
+        Money total;
+
+        for (int j = 0; j < order.count; j++)
+        {
+            int t = legs[j].ticker;
+
+            if ( ! listed[t] || prices[t] <= 0 || action_ticks[t] == tick_count )
+                valid = false;
+            total += legs[j].shares * Money::fromDouble(prices[t]);
+
+            if ( ! buy )
+                reserved_shares[t] -= legs[j].shares;
+        }
+
+        if ( buy )
+            reserved_cash -= order.limit;
+
+        if ( ! valid || ( buy ? total > order.limit : total < order.limit ) )
+            continue;
+
+        for (int j = 0; j < order.count; j++)
+        {
+            int t = legs[j].ticker;
+            int quantity = legs[j].shares;
+            Money price = Money::fromDouble(prices[t]);
+
+            if ( buy )
+            {
+                companies[t]->buy(quantity,price);
+                portfolio.fill(t,quantity,price,quantity * price);
+            }
+            else
+            {
+                Money cost = companies[t]->sell(quantity);
+                portfolio.fill(t,-quantity,price,cost);
+            }
+        }
+
+        ledger.credit(player_account,buy ? -total : total);
+        emit basketFilled(order.basket);
+    }
+
+    basket_orders.clear();
+    basket_order_legs.clear();
+
+    return;
+}
+
+// Pays the equity of the closed positions back to their accounts
+void Market::settleMargin(void)
+{
+    for (int k = 0; k < margin.eventCount(); k++)
+    {
+        const MarginEvent &e = margin.event(k);
+
+        ledger.credit(e.account,e.payout);
+
+        if ( e.account == player_account && e.reason == MarginEvent::Liquidated )
+            emit marginCall(e.ticker);
+    }
+
+    margin.clearEvents();
+
+    return;
+}
+
+Company *Market::company(int t)
+{
+    return companies[t];
+}
+
+QString Market::name(int t) const
+{
+    return names[t];
+}
+
+double Market::price(int t) const
+{
+    return prices[t];
+}
+
+// The first price of the current company
+double Market::openPrice(int t) const
+{
+    return opens[t];
+}
+
+bool Market::isListed(int t) const
+{
+    return listed[t];
+}
+
+// Number of ticks since the market was set up
+int Market::getTickCount(void) const
+{
+    return tick_count;
+}
+
+// When the last tick was finished, on the MetricsRegistry::now() clock
+qint64 Market::getLastTickTime(void) const
+{
+    return last_tick_time;
+}
+
+// Number of prices in the ring of every ticker
+int Market::historyLength(void) const
+{
+    return history_length;
+}
+
+// The ring position that is written on the next tick
+int Market::cursor(void) const
+{
+    return position;
+}
+
+// The ring position written on the last tick
+int Market::lastPosition(void) const
+{
+    return (position + history_length - 1) % history_length;
+}
+
+// Number of prices recorded for the current company, at most history_length
+int Market::historySize(int t) const
+{
+    return qMin(age[t],history_length);
+}
+
+const double *Market::history(int t) const
+{
+    return price_history.constData() + t * history_length;
+}
+
+// Returns the recorded prices of the current company in chronological order, oldest first
+QVector<double> Market::priceHistory(int t) const
+{
+    const double *row = history(t);
+    int n = historySize(t);
+
+    QVector<double> result(n);
+    for (int k = 0; k < n; k++)
+        result[k] = row[(position - n + k + history_length) % history_length];
+
+    return result;
+}
+
+const IndicatorBank &Market::getIndicators(void) const
+{
+    return indicators;
+}
+
+QString Market::newCompanyName(void)
+{
+    QString pool = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    QString name = "___";
+
+    for ( int i = 0; i < 3; i++ )
+    {
+        name[i] = pool[qrand()%25];
+    }
+
+    return name;
+}
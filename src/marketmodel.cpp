@@ -0,0 +1,279 @@
+#include <marketmodel.h>
+#include <market.h>
+#include <mainwindow.h>
+#include <trace.h>
+#include <QBrush>
+#include <QColor>
+#include <algorithm>
+
+// Comparison of two tickers by the current sort column, for std::stable_sort
+struct MarketModelLess
+{
+    const MarketModel *model;
+    bool operator()(int a, int b) const { return model->lessThan(a,b); }
+};
+
+MarketModel::MarketModel(QObject *parent) :
+    QAbstractTableModel(parent),
+    dirty(false),
+    sort_column(-1),
+    sort_order(Qt::AscendingOrder)
+{
+    resetMarket();
+
+    QObject::connect(&market,SIGNAL( resized() ),this,SLOT( resetMarket() ));
+    QObject::connect(&market,SIGNAL( ticked() ),this,SLOT( marketTicked() ));
+    QObject::connect(&render_timer,SIGNAL( timeout() ),this,SLOT( flush() ));
+}
+
+int MarketModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : row_ticker.size();
+}
+
+int MarketModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MarketModel::data(const QModelIndex &index, int role) const
+{
+    if ( ! index.isValid() || index.row() >= row_ticker.size() )
+        return QVariant();
+
+    int t = row_ticker[index.row()];
+    int column = index.column();
+
+    switch (role)
+    {
+    case Qt::UserRole:
+        return t;
+
+    case Qt::DisplayRole:
+        if ( column == Trend )
+            return QVariant();
+        if ( column == Symbol )
+            return market.name(t);
+        if ( column == Shares )
+            return market.company(t)->getShares();
+        if ( column == Change )
+            return QString::number(value(column,t),'f',1) + " %";
+        if ( column == Volatility || column == MaxDrawdown || column == ValueAtRisk )
+            return QString::number(value(column,t),'f',2) + " %";
+        return QString::number(value(column,t),'f',2);
+
+    case Qt::TextAlignmentRole:
+        if ( column == Symbol )
+            return int(Qt::AlignLeft | Qt::AlignVCenter);
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+
+    case Qt::ForegroundRole:
+        if ( column == Change || column == ProfitLoss )
+        {
+            double v = value(column,t);
+            if ( v < 0 )
+                return QBrush(Qt::red);
+            if ( v > 0 )
+                return QBrush(Qt::darkGreen);
+        }
+        return QVariant();
+    }
+
+    return QVariant();
+}
+
+QVariant MarketModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if ( role != Qt::DisplayRole )
+        return QVariant();
+
+    if ( orientation == Qt::Vertical )
+        return section + 1;
+
+    switch (section)
+    {
+    case Symbol:      return QString("Symbol");
+    case Last:        return QString("Last");
+    case Change:      return QString("Change");
+    case Shares:      return QString("Shares");
+    case AvgPrice:    return QString("Avg. price");
+    case ProfitLoss:  return QString("P&L");
+    case Volatility:  return QString("Volatility");
+    case MaxDrawdown: return QString("Max. drawdown");
+    case ValueAtRisk: return QString("VaR %1%").arg(100 * market.getRisk().getConfidence());
+    case Trend:       return QString("Trend");
+    }
+
+    return QVariant();
+}
+
+// Returns the ticker shown in the given row
+int MarketModel::tickerAt(int row) const
+{
+    return row_ticker[row];
+}
+
+double MarketModel::value(int column, int t) const
+{
+    Company *company = market.company(t);
+    double price = market.price(t);
+    double open = market.openPrice(t);
+
+    switch (column)
+    {
+    case Last:        return price;
+    case Change:
+    case Trend:       return open > 0 ? 100 * (price - open) / open : 0;
+    case Shares:      return company->getShares();
+    case AvgPrice:    return company->getAvgPrice().toDouble();
+    case ProfitLoss:  return (company->getShares() * (company->getPrice() - company->getAvgPrice())).toDouble();
+    case Volatility:  return 100 * market.getRisk().value(RiskBank::Volatility,t);
+    case MaxDrawdown: return 100 * market.getRisk().value(RiskBank::MaxDrawdown,t);
+    case ValueAtRisk: return 100 * market.getRisk().value(RiskBank::ValueAtRisk,t);
+    }
+
+    return 0;
+}
+
+bool MarketModel::lessThan(int a, int b) const
+{
+    bool descending = sort_order == Qt::DescendingOrder;
+
+    if ( sort_column == Symbol )
+    {
+        QString name_a = market.name(a), name_b = market.name(b);
+        if ( name_a != name_b )
+            return (name_a < name_b) != descending;
+    }
+    else if ( keys[a] != keys[b] )
+        return (keys[a] < keys[b]) != descending;
+
+    return a < b;
+}
+
+void MarketModel::updateKeys(void)
+{
+    if ( sort_column == Symbol )
+        return;
+
+    for (int t = 0; t < keys.size(); t++)
+        keys[t] = value(sort_column,t);
+
+    return;
+}
+
+void MarketModel::sort(int column, Qt::SortOrder order)
+{
+    sort_column = column >= 0 && column < ColumnCount ? column : -1;
+    sort_order = order;
+
+    updateKeys();
+    reorder(true);
+
+    return;
+}
+
+// Brings the rows into the order of the sort column and moves the persistent
+// indexes (e.g. the selection) along with their tickers. A full sort is only
+// needed when the column changes, after a tick the previous order is nearly
+// sorted and an insertion sort repairs it in close to O(n).
+void MarketModel::reorder(bool full)
+{
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList from = persistentIndexList();
+    QVector<int> tickers;
+    foreach (const QModelIndex &index, from)
+        tickers.append(row_ticker[index.row()]);
+
+    int n = row_ticker.size();
+
+    if ( sort_column < 0 )
+    {
+        for (int r = 0; r < n; r++)
+            row_ticker[r] = r;
+    }
+    else if ( full )
+    {
+        MarketModelLess less = { this };
+        std::stable_sort(row_ticker.begin(),row_ticker.end(),less);
+    }
+    else
+    {
+        for (int r = 1; r < n; r++)
+        {
+            int t = row_ticker[r];
+            int k = r;
+
+            for ( ; k > 0 && lessThan(t,row_ticker[k-1]); k-- )
+                row_ticker[k] = row_ticker[k-1];
+
+            row_ticker[k] = t;
+        }
+    }
+
+    QVector<int> row_of(n);
+    for (int r = 0; r < n; r++)
+        row_of[row_ticker[r]] = r;
+
+    QModelIndexList to;
+    for (int k = 0; k < from.size(); k++)
+        to.append(index(row_of[tickers[k]],from[k].column()));
+    changePersistentIndexList(from,to);
+
+    emit layoutChanged();
+
+    return;
+}
+
+void MarketModel::resetMarket(void)
+{
+    beginResetModel();
+
+    row_ticker.resize(market.size());
+    for (int r = 0; r < row_ticker.size(); r++)
+        row_ticker[r] = r;
+    keys.fill(0,market.size());
+    dirty = false;
+
+    endResetModel();
+
+    if ( sort_column >= 0 )
+        sort(sort_column,sort_order);
+
+    return;
+}
+
+// Only marks the model, the views are updated by the next flush()
+void MarketModel::marketTicked(void)
+{
+    dirty = true;
+
+    return;
+}
+
+void MarketModel::flush(void)
+{
+    TRACE_SPAN("MarketModel::flush");
+
+    if ( ! dirty || row_ticker.isEmpty() )
+        return;
+
+    dirty = false;
+
+    if ( sort_column >= 0 )
+    {
+        updateKeys();
+
+        bool sorted = true;
+        for (int r = 1; r < row_ticker.size() && sorted; r++)
+            sorted = ! lessThan(row_ticker[r],row_ticker[r-1]);
+
+        if ( ! sorted )
+            reorder(false);
+    }
+
+    emit dataChanged(index(0,0),index(row_ticker.size()-1,ColumnCount-1));
+
+    return;
+}
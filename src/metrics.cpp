@@ -0,0 +1,226 @@
+#include <metrics.h>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QTimer>
+#include <QtAlgorithms>
+#include <chrono>
+
+MetricCounter::MetricCounter(void) :
+    count(0)
+{
+}
+
+void MetricCounter::add(quint64 n)
+{
+    count.fetch_add(n,std::memory_order_relaxed);
+
+    return;
+}
+
+quint64 MetricCounter::value(void) const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(void) :
+    total(0), value_sum(0), value_max(0)
+{
+    for (int i = 0; i < histogram_buckets; i++)
+        buckets[i].store(0,std::memory_order_relaxed);
+}
+
+int MetricHistogram::bucketIndex(quint64 value)
+{
+    if ( value < histogram_sub_buckets )
+        return int(value);
+
+    int magnitude = 63 - qCountLeadingZeroBits(value); // >= 4
+
+    return (magnitude - 3) * histogram_sub_buckets + int((value >> (magnitude - 4)) & (histogram_sub_buckets - 1));
+}
+
+quint64 MetricHistogram::bucketMidpoint(int index)
+{
+    if ( index < histogram_sub_buckets )
+        return quint64(index);
+
+    int magnitude = index / histogram_sub_buckets + 3;
+    quint64 width = Q_UINT64_C(1) << (magnitude - 4);
+    quint64 lower = quint64(histogram_sub_buckets + index % histogram_sub_buckets) << (magnitude - 4);
+
+    return lower + width / 2;
+}
+
+void MetricHistogram::record(quint64 value)
+{
+    buckets[bucketIndex(value)].fetch_add(1,std::memory_order_relaxed);
+    total.fetch_add(1,std::memory_order_relaxed);
+    value_sum.fetch_add(value,std::memory_order_relaxed);
+
+    quint64 current = value_max.load(std::memory_order_relaxed);
+    while ( value > current && ! value_max.compare_exchange_weak(current,value,std::memory_order_relaxed) )
+        ;
+
+    return;
+}
+
+quint64 MetricHistogram::count(void) const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+quint64 MetricHistogram::sum(void) const
+{
+    return value_sum.load(std::memory_order_relaxed);
+}
+
+quint64 MetricHistogram::max(void) const
+{
+    return value_max.load(std::memory_order_relaxed);
+}
+
+// Approximate, the value is the midpoint of the bucket holding the quantile
+quint64 MetricHistogram::quantile(double q) const
+{
+    quint64 n = count();
+    if ( n == 0 )
+        return 0;
+
+    quint64 rank = quint64(q * n + 0.5);
+    quint64 seen = 0;
+
+    for (int i = 0; i < histogram_buckets; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if ( seen >= rank && seen > 0 )
+            return qMin(bucketMidpoint(i),max());
+    }
+
+    return max();
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    foreach (const Entry &entry, entries)
+    {
+        delete entry.counter;
+        delete entry.histogram;
+    }
+}
+
+MetricsRegistry::Entry *MetricsRegistry::find(const QString &name)
+{
+    for (int i = 0; i < entries.size(); i++)
+        if ( entries[i].name == name )
+            return &entries[i];
+
+    return 0;
+}
+
+MetricCounter *MetricsRegistry::counter(const QString &name, const QString &help)
+{
+    QMutexLocker lock(&mutex);
+
+    Entry *entry = find(name);
+    if ( entry )
+        return entry->counter;
+
+    Entry created = { name, help, new MetricCounter, 0, 1 };
+    entries.append(created);
+
+    return created.counter;
+}
+
+MetricHistogram *MetricsRegistry::histogram(const QString &name, const QString &help, double scale)
+{
+    QMutexLocker lock(&mutex);
+
+    Entry *entry = find(name);
+    if ( entry )
+        return entry->histogram;
+
+    Entry created = { name, help, 0, new MetricHistogram, scale };
+    entries.append(created);
+
+    return created.histogram;
+}
+
+// All metrics in the Prometheus text exposition format. Histograms are
+// exposed as summaries with a few quantiles.
+QString MetricsRegistry::exposition(void)
+{
+    QMutexLocker lock(&mutex);
+
+    const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    QStringList lines;
+
+    foreach (const Entry &entry, entries)
+    {
+        lines.append("# HELP " + entry.name + " " + entry.help);
+
+        if ( entry.counter )
+        {
+            lines.append("# TYPE " + entry.name + " counter");
+            lines.append(entry.name + " " + QString::number(entry.counter->value()));
+            continue;
+        }
+
+        MetricHistogram *h = entry.histogram;
+
+        lines.append("# TYPE " + entry.name + " summary");
+        for (int k = 0; k < 4; k++)
+            lines.append(QString("%1{quantile=\"%2\"} %3").arg(entry.name).arg(quantiles[k]).arg(h->quantile(quantiles[k]) * entry.scale,0,'g',6));
+        lines.append(QString("%1{quantile=\"1\"} %2").arg(entry.name).arg(h->max() * entry.scale,0,'g',6));
+        lines.append(QString("%1_sum %2").arg(entry.name).arg(h->sum() * entry.scale,0,'g',9));
+        lines.append(QString("%1_count %2").arg(entry.name).arg(h->count()));
+    }
+
+    return lines.join("\n") + "\n";
+}
+
+qint64 MetricsRegistry::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TimerMonitor::TimerMonitor(QTimer *t, const QString &name, QObject *parent) :
+    QObject(parent),
+    timer(t),
+    last(0)
+{
+    events = metrics.counter(name + "_events_total","Timeouts of " + name);
+    late = metrics.counter(name + "_late_total","Timeouts of " + name + " that came more than half an interval late");
+    missed = metrics.counter(name + "_missed_total","Timeouts of " + name + " that were lost because the event loop was busy");
+
+    QObject::connect(timer,SIGNAL( timeout() ),this,SLOT( timeout() ));
+}
+
+void TimerMonitor::restart(void)
+{
+    last = 0;
+
+    return;
+}
+
+void TimerMonitor::timeout(void)
+{
+    qint64 current = MetricsRegistry::now();
+    qint64 interval = qint64(timer->interval()) * 1000000;
+
+    events->add();
+
+    if ( last > 0 && interval > 0 )
+    {
+        qint64 gap = current - last;
+
+        if ( gap > interval + interval / 2 )
+        {
+            late->add();
+            missed->add(quint64((gap + interval / 2) / interval - 1));
+        }
+    }
+
+    last = current;
+
+    return;
+}
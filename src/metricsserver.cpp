@@ -0,0 +1,75 @@
+#include <metricsserver.h>
+#include <metrics.h>
+#include <QCoreApplication>
+#include <QDir>
+#include <QLocalSocket>
+
+MetricsServer::MetricsServer(QObject *parent) :
+    QObject(parent)
+{
+    QObject::connect(&server,SIGNAL( newConnection() ),this,SLOT( newConnection() ));
+}
+
+// STOCKTRADER_METRICS_SOCKET or stocktrader-<pid>.sock in the temp directory,
+// so several instances on one machine do not collide
+QString MetricsServer::defaultPath(void)
+{
+    QString path = QString::fromLocal8Bit(qgetenv("STOCKTRADER_METRICS_SOCKET"));
+
+    if ( path.isEmpty() )
+        path = QDir::temp().filePath(QString("stocktrader-%1.sock").arg(QCoreApplication::applicationPid()));
+
+    return path;
+}
+
+bool MetricsServer::listen(const QString &path)
+{
+    // A socket file left over by a crashed instance would block the name
+    QLocalServer::removeServer(path);
+
+    return server.listen(path);
+}
+
+QString MetricsServer::socketPath(void) const
+{
+    return server.fullServerName();
+}
+
+void MetricsServer::newConnection(void)
+{
+    while ( server.hasPendingConnections() )
+    {
+        QLocalSocket *socket = server.nextPendingConnection();
+
+        QObject::connect(socket,SIGNAL( readyRead() ),this,SLOT( request() ));
+        QObject::connect(socket,SIGNAL( disconnected() ),socket,SLOT( deleteLater() ));
+    }
+
+    return;
+}
+
+void MetricsServer::request(void)
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if ( ! socket )
+        return;
+
+    QByteArray request = socket->readAll();
+    QByteArray body = metrics.exposition().toUtf8();
+
+    // Only answer once per connection
+    QObject::disconnect(socket,SIGNAL( readyRead() ),this,SLOT( request() ));
+
+    if ( request.startsWith("GET") )
+    {
+        socket->write("HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n");
+    }
+
+    socket->write(body);
+    socket->disconnectFromServer();
+
+    return;
+}
@@ -0,0 +1,414 @@
+#include <orderbook.h>
+#include <trace.h>
+#include <limits>
+
+MatchingEngine::MatchingEngine(int n) :
+    tickers(0),
+    orders(order_pool_size), levels(order_pool_size),
+    free_orders(0), free_levels(0), sequence(0),
+    queue(order_queue_size), queue_head(0), queue_size(0),
+    events(2 * order_pool_size), event_count(0)
+{
+    resize(n);
+}
+
+void MatchingEngine::resize(int n)
+{
+    tickers = n;
+    bids.fill(0,n);
+    asks.fill(0,n);
+
+    free_orders = 0;
+    free_levels = 0;
+    for (int k = order_pool_size - 1; k >= 0; k--)
+    {
+        orders[k].id = 0;
+        orders[k].level = 0;
+        orders[k].next = free_orders;
+        free_orders = &orders[k];
+
+        levels[k].next = free_levels;
+        free_levels = &levels[k];
+    }
+
+    queue_head = queue_size = 0;
+    event_count = 0;
+
+    return;
+}
+
+qint64 MatchingEngine::submit(int account, int t, Order::Side side, Order::Type type, int quantity, int price)
+{
+    if ( t < 0 || t >= tickers || quantity <= 0 || ! free_orders || queue_size == order_queue_size )
+        return 0;
+
+    if ( price <= 0 )
+    {
+        if ( type == Order::Limit )
+            return 0;
+        price = side == Order::Buy ? std::numeric_limits<int>::max() : 0;
+    }
+
+    Order *order = free_orders;
+    free_orders = order->next;
+
+    order->id = (++sequence << order_index_bits) | (order - orders.data());
+    order->account = account;
+    order->ticker = t;
+    order->side = side;
+    order->type = type;
+    order->price = price;
+    order->quantity = quantity;
+    order->prev = order->next = 0;
+    order->level = 0;
+
+    enqueue(order->id,false);
+
+    return order->id;
+}
+
+bool MatchingEngine::cancel(qint64 id)
+{
+    if ( ! find(id) || queue_size == order_queue_size )
+        return false;
+
+    enqueue(id,true);
+
+    return true;
+}
+
+// Cancels the resting and the queued orders of the ticker
+void MatchingEngine::cancelAll(int t)
+{
+    while ( bids[t] )
+        cancelOrder(bids[t]->head);
+    while ( asks[t] )
+        cancelOrder(asks[t]->head);
+
+    for (int k = 0; k < queue_size; k++)
+    {
+        Order *order = find(queue[(queue_head + k) % order_queue_size].id);
+        if ( order && order->ticker == t )
+            cancelOrder(order);
+    }
+
+    return;
+}
+
+// Executes the queued orders and cancels and fills the resting orders that
+// the new simulated prices crossed.
+void MatchingEngine::match(const double *prices)
+{
+    TRACE_SPAN("MatchingEngine::match");
+
+    for (int t = 0; t < tickers; t++)
+    {
+        if ( prices[t] > 0 && ( bids[t] || asks[t] ) )
+            cross(t,toTicks(prices[t]));
+    }
+
+    while ( queue_size > 0 )
+    {
+        Command command = queue[queue_head];
+        queue_head = (queue_head + 1) % order_queue_size;
+        queue_size--;
+
+        Order *order = find(command.id);
+        if ( ! order )
+            continue; // filled or cancelled in the meantime
+
+        int market_price = prices[order->ticker] > 0 ? toTicks(prices[order->ticker]) : 0;
+
+        if ( command.cancel || market_price == 0 )
+        {
+            cancelOrder(order);
+            continue;
+        }
+
+        execute(order,market_price);
+
+        if ( ! order->id )
+            continue;
+
+        // Market orders are immediate or cancel
+        if ( order->type == Order::Limit )
+            rest(order);
+        else
+            cancelOrder(order);
+    }
+
+    return;
+}
+
+int MatchingEngine::eventCount(void) const
+{
+    return event_count;
+}
+
+const OrderEvent &MatchingEngine::event(int k) const
+{
+    return events[k];
+}
+
+void MatchingEngine::clearEvents(void)
+{
+    event_count = 0;
+
+    return;
+}
+
+int MatchingEngine::bestBid(int t) const
+{
+    return bids[t] ? bids[t]->price : 0;
+}
+
+int MatchingEngine::bestAsk(int t) const
+{
+    return asks[t] ? asks[t]->price : 0;
+}
+
+int MatchingEngine::toTicks(double price)
+{
+    return qRound(price / price_tick);
+}
+
+double MatchingEngine::fromTicks(int ticks)
+{
+    return ticks * price_tick;
+}
+
+Money MatchingEngine::toMoney(int ticks)
+{
+    static const qint64 units_per_tick = qRound64(price_tick * money_scale);
+
+    return Money::fromUnits(ticks * units_per_tick);
+}
+
+Order *MatchingEngine::find(qint64 id)
+{
+    int index = int(id & ((Q_INT64_C(1) << order_index_bits) - 1));
+
+    if ( id <= 0 || index >= order_pool_size || orders[index].id != id )
+        return 0;
+
+    return &orders[index];
+}
+
+// Fills the order against the opposite side of the book and the market
+// maker, always at the better of both prices. The book has time priority
+// over the market maker at the same price.
+void MatchingEngine::execute(Order *order, int market_price)
+{
+    bool buy = order->side == Order::Buy;
+    QVector<PriceLevel*> &opposite = buy ? asks : bids;
+    int quote = buy ? market_price + maker_half_spread : market_price - maker_half_spread;
+
+    while ( order->quantity > 0 )
+    {
+        PriceLevel *level = opposite[order->ticker];
+        bool book = level && ( buy ? level->price <= order->price : level->price >= order->price );
+        bool maker = quote > 0 && ( buy ? quote <= order->price : quote >= order->price );
+
+        if ( book && ( ! maker || ( buy ? level->price <= quote : level->price >= quote ) ) )
+            fillLevel(level,order);
+        else if ( maker )
+            fill(order,order->quantity,quote);
+        else
+            break;
+    }
+
+    return;
+}
+
+// Fills the order against the queue of the level, oldest order first, at
+// the price of the level. Stops when the order is filled or the level gone.
+void MatchingEngine::fillLevel(PriceLevel *level, Order *order)
+{
+    int price = level->price;
+
+    while ( order->quantity > 0 )
+    {
+        Order *resting = level->head;
+        int quantity = qMin(order->quantity,resting->quantity);
+        bool last = ! resting->next && quantity == resting->quantity;
+
+        fill(resting,quantity,price);
+        fill(order,quantity,price);
+
+        if ( last )
+            break;
+    }
+
+    return;
+}
+
+void MatchingEngine::fill(Order *order, int quantity, int price)
+{
+    order->quantity -= quantity;
+    if ( order->level )
+        order->level->quantity -= quantity;
+
+    report(order,quantity,price,0);
+
+    if ( order->quantity == 0 )
+        close(order);
+
+    return;
+}
+
+void MatchingEngine::cancelOrder(Order *order)
+{
+    int cancelled = order->quantity;
+
+    if ( order->level )
+        unlink(order);
+    order->quantity = 0;
+
+    report(order,0,0,cancelled);
+    close(order);
+
+    return;
+}
+
+// Resting orders are filled completely at their limit once the quote of
+// the market maker reaches it.
+void MatchingEngine::cross(int t, int market_price)
+{
+    while ( bids[t] && bids[t]->price >= market_price + maker_half_spread )
+        fill(bids[t]->head,bids[t]->head->quantity,bids[t]->price);
+
+    while ( asks[t] && asks[t]->price <= market_price - maker_half_spread )
+        fill(asks[t]->head,asks[t]->head->quantity,asks[t]->price);
+
+    return;
+}
+
+// Appends the order to the queue of its price level, the level is created
+// if needed. The pool has as many levels as orders, so it can't run out.
+void MatchingEngine::rest(Order *order)
+{
+    bool buy = order->side == Order::Buy;
+    PriceLevel *&best = buy ? bids[order->ticker] : asks[order->ticker];
+    PriceLevel *prev = 0, *level = best;
+
+    while ( level && ( buy ? level->price > order->price : level->price < order->price ) )
+    {
+        prev = level;
+        level = level->next;
+    }
+
+    if ( ! level || level->price != order->price )
+    {
+        PriceLevel *created = free_levels;
+        free_levels = created->next;
+
+        created->price = order->price;
+        created->quantity = 0;
+        created->head = created->tail = 0;
+        created->prev = prev;
+        created->next = level;
+
+        if ( prev )
+            prev->next = created;
+        else
+            best = created;
+        if ( level )
+            level->prev = created;
+
+        level = created;
+    }
+
+    order->level = level;
+    order->prev = level->tail;
+    order->next = 0;
+
+    if ( level->tail )
+        level->tail->next = order;
+    else
+        level->head = order;
+    level->tail = order;
+    level->quantity += order->quantity;
+
+    return;
+}
+
+// Takes the order out of its level and returns the level to the pool once
+// it is empty.
+void MatchingEngine::unlink(Order *order)
+{
+    PriceLevel *level = order->level;
+
+    if ( order->prev )
+        order->prev->next = order->next;
+    else
+        level->head = order->next;
+
+    if ( order->next )
+        order->next->prev = order->prev;
+    else
+        level->tail = order->prev;
+
+    level->quantity -= order->quantity;
+    order->level = 0;
+
+    if ( level->head )
+        return;
+
+    PriceLevel *&best = order->side == Order::Buy ? bids[order->ticker] : asks[order->ticker];
+
+    if ( level->prev )
+        level->prev->next = level->next;
+    else
+        best = level->next;
+
+    if ( level->next )
+        level->next->prev = level->prev;
+
+    level->next = free_levels;
+    free_levels = level;
+
+    return;
+}
+
+// Returns a done order to the pool
+void MatchingEngine::close(Order *order)
+{
+    if ( order->level )
+        unlink(order);
+
+    order->id = 0;
+    order->next = free_orders;
+    free_orders = order;
+
+    return;
+}
+
+void MatchingEngine::report(const Order *order, int filled, int price, int cancelled)
+{
+    Q_ASSERT(event_count < events.size());
+
+    OrderEvent &e = events[event_count++];
+
+    e.order = order->id;
+    e.account = order->account;
+    e.ticker = order->ticker;
+    e.side = order->side;
+    e.limit = order->price;
+    e.filled = filled;
+    e.price = price;
+    e.cancelled = cancelled;
+    e.remaining = order->quantity;
+
+    return;
+}
+
+void MatchingEngine::enqueue(qint64 id, bool cancel)
+{
+    Command &command = queue[(queue_head + queue_size) % order_queue_size];
+
+    command.id = id;
+    command.cancel = cancel;
+    queue_size++;
+
+    return;
+}
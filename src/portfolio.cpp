@@ -0,0 +1,201 @@
+#include <portfolio.h>
+#include <trace.h>
+
+Portfolio::Portfolio(int n, int length)
+{
+    resize(n,length);
+}
+
+void Portfolio::resize(int n, int length)
+{
+    share_count.fill(0,n);
+    marks.fill(Money(),n);
+    values.fill(Money(),n);
+    costs.fill(Money(),n);
+    holdings_value = cost_total = realized_total = Money();
+
+    // Reserved, so that holding a ticker never allocates
+    held.clear();
+    held.reserve(n);
+    held_index.fill(-1,n);
+
+    samples.fill(PortfolioSample(),length);
+
+    return;
+}
+
+void Portfolio::fill(int t, int quantity, Money price, Money cost)
+{
+    if ( quantity == 0 )
+        return;
+
+    if ( held_index[t] < 0 )
+        hold(t,price);
+
+    if ( quantity > 0 )
+    {
+        costs[t] += cost;
+        cost_total += cost;
+    }
+    else
+    {
+        realized_total += -quantity * price - cost;
+        costs[t] -= cost;
+        cost_total -= cost;
+    }
+
+    share_count[t] += quantity;
+
+    Money value = share_count[t] * marks[t];
+    holdings_value += value - values[t];
+    values[t] = value;
+
+    if ( share_count[t] == 0 )
+        release(t);
+
+    return;
+}
+
+void Portfolio::split(int t, int ratio)
+{
+    if ( held_index[t] < 0 )
+        return;
+
+    rescale(t,share_count[t] * ratio,marks[t] / ratio);
+
+    return;
+}
+
+void Portfolio::consolidate(int t, int ratio)
+{
+    if ( held_index[t] < 0 )
+        return;
+
+    rescale(t,share_count[t] / ratio,ratio * marks[t]);
+
+    return;
+}
+
+void Portfolio::dividend(int t, Money amount)
+{
+    realized_total += share_count[t] * amount;
+
+    return;
+}
+
+// The purchase value of the holding is lost
+void Portfolio::writeOff(int t)
+{
+    if ( held_index[t] < 0 )
+        return;
+
+    realized_total -= costs[t];
+    cost_total -= costs[t];
+    holdings_value -= values[t];
+
+    costs[t] = values[t] = Money();
+    share_count[t] = 0;
+    release(t);
+
+    return;
+}
+
+void Portfolio::mark(const double *prices)
+{
+    TRACE_SPAN("Portfolio::mark");
+
+    for (int k = 0; k < held.size(); k++)
+    {
+        int t = held[k];
+        Money price = Money::fromDouble(prices[t]);
+
+        if ( price == marks[t] || price <= Money() )
+            continue;
+
+        Money delta = share_count[t] * (price - marks[t]);
+
+        holdings_value += delta;
+        values[t] += delta;
+        marks[t] = price;
+    }
+
+    return;
+}
+
+void Portfolio::record(int position, Money cash)
+{
+    PortfolioSample &s = samples[position];
+
+    s.equity = cash + holdings_value;
+    s.unrealized = holdings_value - cost_total;
+    s.realized = realized_total;
+
+    return;
+}
+
+int Portfolio::shares(int t) const
+{
+    return share_count[t];
+}
+
+Money Portfolio::exposure(int t) const
+{
+    return values[t];
+}
+
+Money Portfolio::holdingsValue(void) const
+{
+    return holdings_value;
+}
+
+Money Portfolio::unrealized(void) const
+{
+    return holdings_value - cost_total;
+}
+
+Money Portfolio::realized(void) const
+{
+    return realized_total;
+}
+
+const PortfolioSample &Portfolio::sample(int position) const
+{
+    return samples[position];
+}
+
+void Portfolio::rescale(int t, qint64 shares, Money mark)
+{
+    share_count[t] = shares;
+    marks[t] = mark;
+
+    Money value = share_count[t] * marks[t];
+    holdings_value += value - values[t];
+    values[t] = value;
+
+    return;
+}
+
+// A ticker that wasn't held is marked at the price of its first fill until
+// the next mark()
+void Portfolio::hold(int t, Money price)
+{
+    held_index[t] = held.size();
+    held.append(t);
+    marks[t] = price;
+
+    return;
+}
+
+// Swaps the last held ticker into the place of the released one
+void Portfolio::release(int t)
+{
+    int k = held_index[t];
+    int last = held.last();
+
+    held[k] = last;
+    held_index[last] = k;
+    held.removeLast();
+    held_index[t] = -1;
+
+    return;
+}
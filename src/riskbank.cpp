@@ -0,0 +1,302 @@
+#include <riskbank.h>
+#include <trace.h>
+#include <qmath.h>
+
+const int markers = 5;
+const int measures = 4;
+
+RiskBank::RiskBank(int n, int p, double c) :
+    series_count(0), period(p), confidence(c), head(0),
+    published(0), sequence(0)
+{
+    double q = 1 - confidence;
+    double dn[markers] = { 0, q / 2, q, (1 + q) / 2, 1 };
+
+    for (int i = 0; i < markers; i++)
+        increments[i] = dn[i];
+
+    resize(n);
+}
+
+RiskBank::~RiskBank()
+{
+    delete[] published;
+}
+
+void RiskBank::resize(int n)
+{
+    series_count = n + 1;
+    head = 0;
+
+    window.fill(0, series_count * period);
+    count.fill(0, series_count);
+    last.fill(0, series_count);
+    peak.fill(0, series_count);
+    drawdown.fill(0, series_count);
+    max_drawdown.fill(0, series_count);
+    mean.fill(0, series_count);
+    m2.fill(0, series_count);
+    heights.fill(0, series_count * markers);
+    positions.fill(0, series_count * markers);
+    desired.fill(0, series_count * markers);
+
+    delete[] published;
+    published = new std::atomic<double>[series_count * measures];
+    for (int k = 0; k < series_count * measures; k++)
+        published[k].store(0,std::memory_order_relaxed);
+
+    return;
+}
+
+// Starts the series over, e.g. when a new company is placed on the ticker.
+// The ring buffer is left alone, slots are only read once they have been
+// written again.
+void RiskBank::reset(int s)
+{
+    sequence.fetch_add(1,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    clear(s);
+    sequence.fetch_add(1,std::memory_order_release);
+
+    return;
+}
+
+// Returns don't change with the price level, only the last and the highest value do
+void RiskBank::scale(int s, double f)
+{
+    last[s] *= f;
+    peak[s] *= f;
+
+    return;
+}
+
+void RiskBank::update(const double *prices, double equity)
+{
+    TRACE_SPAN("RiskBank::update");
+
+    // Odd while writing, readers retry
+    sequence.fetch_add(1,std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int s = 0; s < series_count; s++)
+    {
+        double v = s < series_count - 1 ? prices[s] : equity;
+
+        // A series without a value (a delisted ticker) starts over once it has one again
+        if ( v <= 0 )
+        {
+            if ( last[s] > 0 )
+                clear(s);
+            continue;
+        }
+
+        if ( last[s] > 0 )
+            addReturn(s,qLn(v / last[s]));
+
+        last[s] = v;
+        peak[s] = qMax(peak[s],v);
+        drawdown[s] = 1 - v / peak[s];
+        max_drawdown[s] = qMax(max_drawdown[s],drawdown[s]);
+
+        publish(s);
+    }
+
+    head = (head + 1) % period;
+
+    sequence.fetch_add(1,std::memory_order_release);
+
+    return;
+}
+
+double RiskBank::value(Measure m, int s) const
+{
+    RiskSnapshot snap = snapshot(s);
+
+    switch (m)
+    {
+    case Volatility:  return snap.volatility;
+    case Drawdown:    return snap.drawdown;
+    case MaxDrawdown: return snap.max_drawdown;
+    case ValueAtRisk: return snap.value_at_risk;
+    }
+
+    return 0;
+}
+
+RiskSnapshot RiskBank::snapshot(int s) const
+{
+    RiskSnapshot snap;
+    const std::atomic<double> *p = published + s * measures;
+    quint32 before, after;
+
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+
+        snap.volatility = p[Volatility].load(std::memory_order_relaxed);
+        snap.drawdown = p[Drawdown].load(std::memory_order_relaxed);
+        snap.max_drawdown = p[MaxDrawdown].load(std::memory_order_relaxed);
+        snap.value_at_risk = p[ValueAtRisk].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    }
+    while ( ( before & 1 ) || before != after );
+
+    return snap;
+}
+
+int RiskBank::portfolioSeries(void) const
+{
+    return series_count - 1;
+}
+
+double RiskBank::getConfidence(void) const
+{
+    return confidence;
+}
+
+void RiskBank::clear(int s)
+{
+    count[s] = 0;
+    last[s] = peak[s] = 0;
+    drawdown[s] = max_drawdown[s] = 0;
+    mean[s] = m2[s] = 0;
+
+    publish(s);
+
+    return;
+}
+
+// Welford's update, sliding once the window is full: the return that
+// leaves the window is the one written 'period' updates ago in this slot.
+void RiskBank::addReturn(int s, double r)
+{
+    double &slot = window[head * series_count + s];
+    int n = ++count[s];
+
+    if ( n <= period )
+    {
+        double delta = r - mean[s];
+        mean[s] += delta / n;
+        m2[s] += delta * (r - mean[s]);
+    }
+    else
+    {
+        double old = slot;
+        double old_mean = mean[s];
+
+        mean[s] += (r - old) / period;
+        m2[s] = qMax(0.0,m2[s] + (r - old) * (r - mean[s] + old - old_mean));
+    }
+
+    slot = r;
+
+    addQuantileSample(s,r);
+
+    return;
+}
+
+// One step of the P-square algorithm (Jain and Chlamtac): the five markers
+// estimate the minimum, the q/2, q and (1+q)/2 quantiles and the maximum.
+// The first five returns are the markers themselves.
+void RiskBank::addQuantileSample(int s, double r)
+{
+    double *h = heights.data() + s * markers;
+    double *n = positions.data() + s * markers;
+    double *np = desired.data() + s * markers;
+    int seen = count[s];
+
+    if ( seen <= markers )
+    {
+        // Insertion into the sorted first returns
+        int k = seen - 1;
+        for ( ; k > 0 && h[k-1] > r; k-- )
+            h[k] = h[k-1];
+        h[k] = r;
+
+        if ( seen == markers )
+        {
+            for (int i = 0; i < markers; i++)
+            {
+                n[i] = i;
+                np[i] = 4 * increments[i];
+            }
+        }
+        return;
+    }
+
+    int k;
+    if ( r < h[0] )
+    {
+        h[0] = r;
+        k = 0;
+    }
+    else if ( r >= h[4] )
+    {
+        h[4] = r;
+        k = 3;
+    }
+    else
+    {
+        k = 0;
+        while ( r >= h[k+1] )
+            k++;
+    }
+
+    for (int i = k + 1; i < markers; i++)
+        n[i] += 1;
+    for (int i = 0; i < markers; i++)
+        np[i] += increments[i];
+
+    // Move the middle markers towards their desired positions
+    for (int i = 1; i < markers - 1; i++)
+    {
+        double d = np[i] - n[i];
+
+        if ( ( d >= 1 && n[i+1] - n[i] > 1 ) || ( d <= -1 && n[i-1] - n[i] < -1 ) )
+        {
+            int sign = d > 0 ? 1 : -1;
+            double parabolic = h[i] + sign / (n[i+1] - n[i-1]) *
+                               ( (n[i] - n[i-1] + sign) * (h[i+1] - h[i]) / (n[i+1] - n[i]) +
+                                 (n[i+1] - n[i] - sign) * (h[i] - h[i-1]) / (n[i] - n[i-1]) );
+
+            if ( h[i-1] < parabolic && parabolic < h[i+1] )
+                h[i] = parabolic;
+            else
+                h[i] += sign * (h[i+sign] - h[i]) / (n[i+sign] - n[i]);
+
+            n[i] += sign;
+        }
+    }
+
+    return;
+}
+
+// The 1 - confidence quantile of the returns, the nearest one of the first
+// returns as long as there are fewer than five
+double RiskBank::quantile(int s) const
+{
+    int seen = count[s];
+    const double *h = heights.constData() + s * markers;
+
+    if ( seen == 0 )
+        return 0;
+    if ( seen < markers )
+        return h[qMin(seen - 1,int((1 - confidence) * seen))];
+
+    return h[2];
+}
+
+void RiskBank::publish(int s)
+{
+    std::atomic<double> *p = published + s * measures;
+    int n = qMin(count[s],period);
+
+    p[Volatility].store(n > 1 ? qSqrt(m2[s] / (n - 1)) : 0,std::memory_order_relaxed);
+    p[Drawdown].store(drawdown[s],std::memory_order_relaxed);
+    p[MaxDrawdown].store(max_drawdown[s],std::memory_order_relaxed);
+    p[ValueAtRisk].store(qMax(0.0,1 - qExp(quantile(s))),std::memory_order_relaxed);
+
+    return;
+}
@@ -3,29 +3,80 @@
 #include <mainwindow.h>
 #include <QTimer>
 #include <company.h>
-
-int xmax = 600;
+#include <market.h>
 
 SingleStock::SingleStock(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::SingleStock),
-    buy_step(1)
+    buy_step(1),
+    ticker(-1)
 {
     ui->setupUi(this);
 
-    ui->plot->initCompanyPlot(xmax,100);
-
     QObject::connect(ui->plot,SIGNAL( priceChanged(int) ),ui->lcdPrice,SLOT( display(int) ));
-    QObject::connect(&main_timer,SIGNAL( timeout() ),ui->plot,SLOT( setData()));
     QObject::connect(ui->buyButton,SIGNAL( clicked() ),this,SLOT( buyStock() ));
     QObject::connect(ui->sellButton,SIGNAL( clicked() ),this,SLOT( sellStock() ));
+    QObject::connect(ui->triggerButton,SIGNAL( clicked() ),this,SLOT( setTrigger() ));
+    QObject::connect(ui->clearTriggersButton,SIGNAL( clicked() ),this,SLOT( clearTriggers() ));
+    QObject::connect(ui->longButton,SIGNAL( clicked() ),this,SLOT( openLong() ));
+    QObject::connect(ui->shortButton,SIGNAL( clicked() ),this,SLOT( openShort() ));
+    QObject::connect(ui->closePositionsButton,SIGNAL( clicked() ),this,SLOT( closePositions() ));
     QObject::connect(ui->orderStep,SIGNAL( valueChanged(int) ),this,SLOT( changeBuyStep(int) ));
+    QObject::connect(ui->candleBox,SIGNAL( toggled(bool) ),ui->plot,SLOT( setCandleChart(bool) ));
+    QObject::connect(ui->indicatorBox,SIGNAL( toggled(bool) ),ui->plot,SLOT( setIndicators(bool) ));
 
     // Financial signals
-    QObject::connect(ui->plot,SIGNAL( bankrupt(void) ),this,SLOT( bankrupt(void) ));
-    QObject::connect(ui->plot,SIGNAL( splitted(void) ),this,SLOT( split(void) ));
+    QObject::connect(&market,SIGNAL( bankrupt(int) ),this,SLOT( bankrupt(int) ));
+    QObject::connect(&market,SIGNAL( relisted(int) ),this,SLOT( relisted(int) ));
+    QObject::connect(&market,SIGNAL( splitted(int) ),this,SLOT( split(int) ));
+    QObject::connect(&market,SIGNAL( depotChanged(int) ),this,SLOT( depotChanged(int) ));
+    QObject::connect(&market,SIGNAL( basketFilled(int) ),this,SLOT( basketFilled(int) ));
+    QObject::connect(&market,SIGNAL( marginCall(int) ),this,SLOT( marginCall(int) ));
+}
+
+// Shows the given ticker. Only bound panels follow the market ticks and
+// the frames of render_timer.
+void SingleStock::bindTicker(int t)
+{
+    if ( t == ticker )
+        return;
+
+    if ( ticker < 0 )
+    {
+        QObject::connect(&market,SIGNAL( ticked() ),ui->plot,SLOT( setData()));
+        QObject::connect(&render_timer,SIGNAL( timeout() ),ui->plot,SLOT( render()));
+    }
+
+    ticker = t;
+
+    ui->stockNameLbl->setText(market.name(ticker));
+    ui->lcdStocks->display(market.company(ticker)->shares_in_depot);
+    ui->plot->bindTicker(ticker);
+
+    if ( market.isListed(ticker) )
+        clearPriceBG();
+    else
+        bankrupt(ticker);
+
+    return;
+}
+
+void SingleStock::unbind(void)
+{
+    if ( ticker < 0 )
+        return;
+
+    QObject::disconnect(&market,SIGNAL( ticked() ),ui->plot,SLOT( setData()));
+    QObject::disconnect(&render_timer,SIGNAL( timeout() ),ui->plot,SLOT( render()));
+
+    ticker = -1;
 
-    setCompanyName();
+    return;
+}
+
+int SingleStock::getTicker(void)
+{
+    return ticker;
 }
 
 void SingleStock::changeBuyStep(int n)
@@ -35,44 +86,126 @@ void SingleStock::changeBuyStep(int n)
     return;
 }
 
+// Orders are market orders that the market fills at the next tick, the
+// depot and the ledger change once they are filled (see depotChanged()).
+// The market rejects them if there isn't enough money or shares.
 void SingleStock::buyStock(void)
 {
-    double current_price = ui->plot->company.getPrice();
-    double order_volume = buy_step * current_price;
+    if ( ticker < 0 || ! main_timer.isActive() )
+        return;
+
+    double limit = market.price(ticker) * (1 + market_order_protection);
+
+    market.submitOrder(ticker,player_account,Order::Buy,Order::Market,buy_step,limit);
+
+    return;
+}
+
+void SingleStock::sellStock(void)
+{
+    if ( ticker < 0 || ! main_timer.isActive() )
+        return;
+
+    double limit = market.price(ticker) * (1 - market_order_protection);
+
+    market.submitOrder(ticker,player_account,Order::Sell,Order::Market,buy_step,limit);
+
+    return;
+}
 
-    if (ui->plot->company.is_bankrupt || ! main_timer.isActive() || deposit.getMoney() - order_volume < 0)
+// Sells buy_step shares once the price moves the given percentage away
+// from the current one: down for stop losses, up for take profits, and
+// down from the highest price since now for trailing stops.
+void SingleStock::setTrigger(void)
+{
+    if ( ticker < 0 || ! main_timer.isActive() )
         return;
 
-    deposit.changeMoney(deposit.getMoney()-order_volume);
+    Trigger::Kind kind = Trigger::Kind(ui->triggerKind->currentIndex());
+    double distance = market.price(ticker) * ui->triggerDistance->value() / 100;
+    double price = distance;
 
-    ui->plot->company.buy(buy_step);
+    if ( kind == Trigger::StopLoss )
+        price = market.price(ticker) - distance;
+    else if ( kind == Trigger::TakeProfit )
+        price = market.price(ticker) + distance;
 
-    ui->lcdStocks->display(ui->plot->company.shares_in_depot);
+    market.placeTrigger(ticker,player_account,kind,buy_step,price);
 
     return;
 }
 
-void SingleStock::sellStock(void)
+void SingleStock::clearTriggers(void)
 {
+    if ( ticker < 0 )
+        return;
+
+    market.cancelTriggers(ticker,player_account);
+
+    return;
+}
 
-    if (ui->plot->company.is_bankrupt || ! main_timer.isActive() || ui->plot->company.shares_in_depot - buy_step < 0)
+// Positions of buy_step shares at the price of the last tick, half of
+// their value is taken from the money as collateral. They are liquidated
+// once the equity falls below a quarter of their value.
+void SingleStock::openLong(void)
+{
+    if ( ticker < 0 || ! main_timer.isActive() )
         return;
 
-    double current_price = ui->plot->company.getPrice();
-    double order_volume = buy_step * current_price;
+    market.openPosition(ticker,player_account,buy_step);
 
-    deposit.changeMoney(deposit.getMoney()+order_volume);
+    return;
+}
 
-    ui->plot->company.sell(buy_step);
+void SingleStock::openShort(void)
+{
+    if ( ticker < 0 || ! main_timer.isActive() )
+        return;
 
-    ui->lcdStocks->display(ui->plot->company.shares_in_depot);
+    market.openPosition(ticker,player_account,-buy_step);
 
     return;
 }
 
-// Only updates the LCD displays
-void SingleStock::split(void)
+void SingleStock::closePositions(void)
 {
+    if ( ticker < 0 || ! main_timer.isActive() )
+        return;
+
+    market.closePositions(ticker,player_account);
+
+    return;
+}
+
+void SingleStock::depotChanged(int t)
+{
+    if ( t != ticker )
+        return;
+
+    ui->lcdStocks->display(market.company(ticker)->shares_in_depot);
+
+    return;
+}
+
+// The basket may not contain the ticker, showing the depot is cheap enough
+void SingleStock::basketFilled(int)
+{
+    if ( ticker < 0 )
+        return;
+
+    ui->lcdStocks->display(market.company(ticker)->shares_in_depot);
+
+    return;
+}
+
+// Splits and reverse splits. The market adjusted the recorded prices, so
+// the plot is rebuilt from them.
+void SingleStock::split(int t)
+{
+    if ( t != ticker )
+        return;
+
     QPalette Pal;
     Pal.setColor(QPalette::Background,Qt::green);
     ui->lcdPrice->setAutoFillBackground(true);
@@ -80,62 +213,62 @@ void SingleStock::split(void)
 
     QTimer::singleShot(60*main_timer_interval,this,SLOT( clearPriceBG() ));
 
-    ui->lcdStocks->display(ui->plot->company.shares_in_depot);
+    ui->lcdStocks->display(market.company(ticker)->shares_in_depot);
+    ui->plot->bindTicker(ticker);
 
     return;
 }
 
-void SingleStock::bankrupt(void)
+// A margin position was liquidated
+void SingleStock::marginCall(int t)
 {
-    ui->lcdStocks->display(0);
-    ui->lcdPrice->display(0);
-    ui->lcdPrice->setAutoFillBackground(true);
-
-    QObject::disconnect(&main_timer,SIGNAL( timeout() ),ui->plot,SLOT( setData()));
+    if ( t != ticker )
+        return;
 
     QPalette Pal;
-    Pal.setColor(QPalette::Background,Qt::red);
+    Pal.setColor(QPalette::Background,QColor(255,165,0));
     ui->lcdPrice->setAutoFillBackground(true);
     ui->lcdPrice->setPalette(Pal);
 
-    // A QTimer object would be destructed before firing!
-    // Time to wait before placing a new company on this stock position
-    QTimer::singleShot(60*main_timer_interval,this,SLOT( reInit()));
+    QTimer::singleShot(60*main_timer_interval,this,SLOT( clearPriceBG() ));
 
     return;
 }
 
-void SingleStock::reInit(void)
+// The market places a new company on the ticker after relist_delay ticks
+void SingleStock::bankrupt(int t)
 {
-    ui->plot->initCompanyPlot(xmax,100);
-    setCompanyName();
+    if ( t != ticker )
+        return;
 
-    clearPriceBG();
+    ui->lcdStocks->display(0);
+    ui->lcdPrice->display(0);
+    ui->lcdPrice->setAutoFillBackground(true);
 
-    QObject::connect(&main_timer,SIGNAL( timeout() ),ui->plot,SLOT( setData()));
+    QPalette Pal;
+    Pal.setColor(QPalette::Background,Qt::red);
+    ui->lcdPrice->setAutoFillBackground(true);
+    ui->lcdPrice->setPalette(Pal);
 
     return;
 }
 
-void SingleStock::clearPriceBG(void)
+void SingleStock::relisted(int t)
 {
-    ui->lcdPrice->setAutoFillBackground(false);
+    if ( t != ticker )
+        return;
+
+    ui->stockNameLbl->setText(market.name(ticker));
+    ui->plot->bindTicker(ticker);
+
+    clearPriceBG();
 
     return;
 }
 
-void SingleStock::setCompanyName(void)
+void SingleStock::clearPriceBG(void)
 {
-    QString pool = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    QString name = "___";
-
-
-    for ( int i = 0; i < 3; i++ )
-    {
-        name[i] = pool[qrand()%25];
-    }
-
-    ui->stockNameLbl->setText(name);
+    ui->lcdPrice->setAutoFillBackground(false);
 
     return;
 }
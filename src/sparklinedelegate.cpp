@@ -0,0 +1,221 @@
+#include <sparklinedelegate.h>
+#include <market.h>
+#include <QPainter>
+
+SparklineDelegate::SparklineDelegate(QObject *parent) :
+    QStyledItemDelegate(parent)
+{
+    QObject::connect(&market,SIGNAL( resized() ),this,SLOT( clearCache() ));
+    QObject::connect(&market,SIGNAL( splitted(int) ),this,SLOT( dropSparkline(int) ));
+    QObject::connect(&market,SIGNAL( relisted(int) ),this,SLOT( dropSparkline(int) ));
+}
+
+void SparklineDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // Background and selection
+    QStyledItemDelegate::paint(painter,option,index);
+
+    QRect rect = option.rect.adjusted(2,2,-2,-2);
+    if ( rect.width() < 2 || rect.height() < 2 )
+        return;
+
+    int ticker = index.data(Qt::UserRole).toInt();
+
+    if ( cache.size() > max_cached_sparklines && ! cache.contains(ticker) )
+        cache.clear();
+
+    Sparkline &sparkline = cache[ticker];
+
+    if ( sparkline.image.size() != rect.size() )
+    {
+        sparkline.image = QImage(rect.size(),QImage::Format_ARGB32_Premultiplied);
+        sparkline.tick = -1;
+    }
+
+    // The prices of a delisted company don't move until it is relisted
+    if ( sparkline.tick != market.getTickCount() && ( sparkline.tick < 0 || market.isListed(ticker) ) )
+    {
+        decimate(sparkline,ticker);
+        render(sparkline,ticker);
+    }
+
+    painter->drawImage(rect.topLeft(),sparkline.image);
+
+    return;
+}
+
+QSize SparklineDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    QSize size = QStyledItemDelegate::sizeHint(option,index);
+
+    return QSize(qMax(size.width(),120),size.height());
+}
+
+void SparklineDelegate::clearCache(void)
+{
+    cache.clear();
+
+    return;
+}
+
+void SparklineDelegate::dropSparkline(int ticker)
+{
+    cache.remove(ticker);
+
+    return;
+}
+
+// Brings the buckets up to the last tick. The price of tick k is at ring
+// position k % historyLength(), see Market::cursor(). The ticks that fell
+// out of the history only matter for the oldest bucket, which is refilled
+// if its minimum or maximum was one of them.
+void SparklineDelegate::decimate(Sparkline &sparkline, int ticker) const
+{
+    const double *row = market.history(ticker);
+    int history_length = market.historyLength();
+    int n = market.historySize(ticker);
+    int end = market.getTickCount(); // one past the newest tick
+    int begin = end - n;             // the oldest tick
+    int width = sparkline.image.width();
+    int capacity = width + 2;
+    int bucket_size = qMax(1,(n + width - 1) / width);
+    int from = sparkline.tick;
+
+    bool incremental = sparkline.tick >= 0 && sparkline.bucket_size == bucket_size
+        && sparkline.buckets.size() == capacity && end - sparkline.tick <= n
+        && n == qMin(sparkline.size + end - sparkline.tick,history_length);
+
+    if ( ! incremental )
+    {
+        sparkline.bucket_size = bucket_size;
+        sparkline.buckets.resize(capacity);
+        sparkline.first = sparkline.last = -1;
+        from = begin;
+    }
+
+    for (int k = from; k < end; k++)
+    {
+        double v = row[k % history_length];
+        int b = k / bucket_size;
+        Bucket &bucket = sparkline.buckets[b % capacity];
+
+        if ( b > sparkline.last )
+        {
+            bucket.min = bucket.max = v;
+            bucket.min_tick = bucket.max_tick = k;
+            sparkline.last = b;
+            if ( sparkline.first < 0 )
+                sparkline.first = b;
+        }
+        else if ( v < bucket.min )
+        {
+            bucket.min = v;
+            bucket.min_tick = k;
+        }
+        else if ( v > bucket.max )
+        {
+            bucket.max = v;
+            bucket.max_tick = k;
+        }
+    }
+
+    if ( sparkline.last >= 0 )
+    {
+        sparkline.first = qMax(sparkline.first,begin / bucket_size);
+
+        Bucket &bucket = sparkline.buckets[sparkline.first % capacity];
+
+        if ( bucket.min_tick < begin || bucket.max_tick < begin )
+        {
+            int to = qMin((sparkline.first + 1) * bucket_size,end);
+
+            bucket.min = bucket.max = row[begin % history_length];
+            bucket.min_tick = bucket.max_tick = begin;
+
+            for (int k = begin + 1; k < to; k++)
+            {
+                double v = row[k % history_length];
+
+                if ( v < bucket.min )
+                {
+                    bucket.min = v;
+                    bucket.min_tick = k;
+                }
+                else if ( v > bucket.max )
+                {
+                    bucket.max = v;
+                    bucket.max_tick = k;
+                }
+            }
+        }
+    }
+
+    sparkline.tick = end;
+    sparkline.size = n;
+
+    return;
+}
+
+// Every bucket gets its minimum and its maximum, in the order they
+// occurred, so the line keeps all spikes with at most 2 points per pixel
+// column.
+void SparklineDelegate::render(Sparkline &sparkline, int ticker) const
+{
+    QImage &image = sparkline.image;
+    image.fill(Qt::transparent);
+
+    int n = sparkline.size;
+    if ( n < 2 )
+        return;
+
+    const double *row = market.history(ticker);
+    int history_length = market.historyLength();
+    int end = sparkline.tick, begin = end - n;
+    int width = image.width(), height = image.height();
+    int capacity = sparkline.buckets.size();
+    int bucket_size = sparkline.bucket_size;
+
+    points.resize(2 * (sparkline.last - sparkline.first + 1));
+    int count = 0;
+    double lower = row[begin % history_length], upper = lower;
+
+    for (int b = sparkline.first; b <= sparkline.last; b++)
+    {
+        const Bucket &bucket = sparkline.buckets[b % capacity];
+        int from = qMax(b * bucket_size,begin), to = qMin((b + 1) * bucket_size,end);
+        double x = (0.5 * (from + to) - begin) * width / n;
+
+        lower = qMin(lower,bucket.min);
+        upper = qMax(upper,bucket.max);
+
+        if ( bucket.min_tick == bucket.max_tick )
+            points[count++] = QPointF(x,bucket.min);
+        else if ( bucket.min_tick < bucket.max_tick )
+        {
+            points[count++] = QPointF(x,bucket.min);
+            points[count++] = QPointF(x,bucket.max);
+        }
+        else
+        {
+            points[count++] = QPointF(x,bucket.max);
+            points[count++] = QPointF(x,bucket.min);
+        }
+    }
+
+    // Map the prices onto the image height
+    double span = upper - lower;
+    for (int k = 0; k < count; k++)
+    {
+        double v = points[k].y();
+        points[k].setY(span > 0 ? (height - 1) - (v - lower) / span * (height - 2) : height / 2.0);
+    }
+
+    bool rising = row[(end - 1) % history_length] >= row[begin % history_length];
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(rising ? Qt::darkGreen : Qt::red,1));
+    painter.drawPolyline(points.constData(),count);
+
+    return;
+}
@@ -0,0 +1,100 @@
+#include <stockgrid.h>
+#include <market.h>
+#include <QScrollBar>
+
+StockGrid::StockGrid(QWidget *parent) :
+    QAbstractScrollArea(parent)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setFrameShape(QFrame::NoFrame);
+
+    QObject::connect(&market,SIGNAL( resized() ),this,SLOT( rebind() ));
+}
+
+// All tickers got new companies, so every panel has to be bound again
+void StockGrid::rebind(void)
+{
+    foreach (SingleStock *panel, panels)
+        panel->unbind();
+
+    relayout();
+
+    return;
+}
+
+// Places the panels on the visible cells and binds them to the tickers
+// of those cells. Called on every resize and scroll step.
+void StockGrid::relayout(void)
+{
+    int n = market.size();
+    int width = viewport()->width();
+    int height = viewport()->height();
+
+    int columns = qMax(1,width / panel_min_width);
+    int rows = (n + columns - 1) / columns;
+
+    // Stretch the cells over the window as long as the whole market fits
+    int cell_width = width / columns;
+    int cell_height = panel_min_height;
+    if ( rows > 0 && rows * panel_min_height <= height )
+        cell_height = height / rows;
+
+    verticalScrollBar()->setRange(0,qMax(0,rows * cell_height - height));
+    verticalScrollBar()->setPageStep(height);
+    verticalScrollBar()->setSingleStep(cell_height / 10);
+
+    int offset = verticalScrollBar()->value();
+    int first_row = offset / cell_height;
+    int visible_rows = qMin(rows - first_row,height / cell_height + 2);
+    int first = first_row * columns;
+    int count = qMin(n - first,visible_rows * columns);
+
+    // A ticker always gets the panel (ticker mod pool size), so the panels
+    // of the tickers that stay visible during a scroll step keep their data.
+    int pool = qMax(0,(height / cell_height + 2) * columns);
+    while ( panels.size() < pool )
+        panels.append(new SingleStock(viewport()));
+
+    QVector<bool> used(panels.size(),false);
+
+    for (int t = first; t < first + count; t++)
+    {
+        SingleStock *panel = panels[t % pool];
+        int row = t / columns;
+        int column = t % columns;
+
+        panel->setGeometry(column * cell_width,row * cell_height - offset,cell_width,cell_height);
+        panel->bindTicker(t);
+        panel->show();
+
+        used[t % pool] = true;
+    }
+
+    for (int k = 0; k < panels.size(); k++)
+    {
+        if ( used[k] )
+            continue;
+
+        panels[k]->unbind();
+        panels[k]->hide();
+    }
+
+    return;
+}
+
+void StockGrid::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    relayout();
+
+    return;
+}
+
+void StockGrid::scrollContentsBy(int, int)
+{
+    relayout();
+
+    return;
+}
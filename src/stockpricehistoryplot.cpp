@@ -1,51 +1,103 @@
 
 #include <stockpricehistoryplot.h>
 #include <company.h>
+#include <trace.h>
+#include <allocationcounter.h>
 #include <iostream>
 
 StockPriceHistoryPlot::StockPriceHistoryPlot(QWidget *parent) :
-    QCustomPlot(parent)
+    QCustomPlot(parent),
+    ticker(-1), stale(false), dirty(false),
+    candles(0),
+    candle_chart(false), show_indicators(false),
+    cursor_line(0),
+    hover_index(-1),
+    xmax(default_history_length-1), ymax(100),
+    replot_begin(0), frame_tick_time(0)
 {
-    company.initCompany();
+    replot_time = metrics.histogram("stocktrader_replot_seconds","Duration of one price plot replot");
+    paint_latency = metrics.histogram("stocktrader_tick_to_paint_seconds","Time from the end of a market tick until a plot showing it is painted");
+
+    QObject::connect(this,SIGNAL( beforeReplot() ),this,SLOT( replotStarted() ));
+    QObject::connect(this,SIGNAL( afterReplot() ),this,SLOT( replotFinished() ));
+
+    initPlot();
+    initCrosshair();
 }
 
-void StockPriceHistoryPlot::initCompanyPlot(int mx, double my)
+// Shows the given ticker of the market. The series are rebuilt once from the
+// recorded history, after that setData() only replaces the newest tick.
+void StockPriceHistoryPlot::bindTicker(int t)
 {
-    i = 0;
-    xmax = mx;
-    ymax = my;
+    ALLOCATION_PHASE(phase_event); // also when a hidden plot catches up in setData()
 
-    company.initCompany(ymax);
+    ticker = t;
+    stale = false;
+    xmax = market.historyLength()-1;
+    ymax = market.company(ticker)->ymax;
 
-    y.fill(0,xmax+1);
-    x.resize(xmax+1);
-    avg.fill(0,2);
-    avgx.fill(0,2);
-    update_limit.fill(0,2);
-    update_limitx.fill(0,2);
+    const double *row = market.history(ticker);
 
-    update_limit[0] = 0;
-    update_limit[0] = ymax;
-    avgx[0] = 0;
-    avgx[1] = xmax;
+    y.resize(xmax+1);
+    x.resize(xmax+1);
 
-    for (int i = 0; i < xmax; i++)
+    for (int i = 0; i <= xmax; i++)
     {
         x[i] = i;
+        y[i] = row[i];
     }
 
-    initPlot();
+    this->xAxis->setRange(0,xmax);
+    this->yAxis->setRange(0,ymax);
+
+    // The keys are fixed from here on, the ticks only replace values in place
+    this->graph(0)->setData(x,y);
+    this->graph(1)->clearData();
+    this->graph(1)->addData(0,0);
+    this->graph(1)->addData(xmax,0);
+    // Every position has an indicator point, NaN until the indicator is
+    // ready there, which leaves a gap in the line
+    QVector<double> gaps(xmax+1,qQNaN());
+    for (int k = 2; k < 5; k++)
+        this->graph(k)->setData(x,gaps);
+
+    candles->clearData();
+    candles->reserve(xmax / ticks_per_candle + 1);
+
+    // Replay the recorded prices for the candles and the indicator series
+    QVector<double> history = market.priceHistory(ticker);
+    IndicatorBank replay;
+    int first = market.cursor() - history.size() + xmax + 1;
+
+    for (int k = 0; k < history.size(); k++)
+    {
+        int position = (first + k) % (xmax+1);
+
+        replay.update(&history[k]);
+        appendIndicators(position,replay,0);
+        candles->addTick((position / ticks_per_candle) * ticks_per_candle + 0.5 * ticks_per_candle, history[k]);
+    }
+
+    hover_index = -1;
+    updateCrosshair();
+
+    dirty = true;
+    render();
 
     return;
 }
 
-void StockPriceHistoryPlot::initPlot(void)
+int StockPriceHistoryPlot::getTicker(void)
 {
-    this->hide();
+    return ticker;
+}
 
-    this->removeGraph(0);
-    this->removeGraph(1);
-    this->removeGraph(2);
+// Sets up the graphs once, bindTicker() only replaces their data
+void StockPriceHistoryPlot::initPlot(void)
+{
+    this->addGraph();
+    this->addGraph();
+    // Indicator graphs: SMA, upper and lower Bollinger band
     this->addGraph();
     this->addGraph();
     this->addGraph();
@@ -58,45 +110,274 @@ void StockPriceHistoryPlot::initPlot(void)
     this->graph(0)->setPen(QPen(Qt::red));
     this->graph(0)->setBrush(QBrush(QColor(255,0,0,30)));
     this->graph(1)->setPen(QPen(Qt::green));
-    this->graph(2)->setPen(QPen(Qt::blue));
+    this->graph(2)->setPen(QPen(QColor(255,140,0)));
+    this->graph(3)->setPen(QPen(Qt::gray,1,Qt::DashLine));
+    this->graph(4)->setPen(QPen(Qt::gray,1,Qt::DashLine));
+
+    this->graph(0)->setVisible(!candle_chart);
+    for (int k = 2; k < 5; k++)
+        this->graph(k)->setVisible(show_indicators);
 
-    this->show();
+    candles = new QCPFinancial(this->xAxis,this->yAxis);
+    this->addPlottable(candles);
+    candles->setWidth(0.8 * ticks_per_candle);
+    candles->setVisible(candle_chart);
+
+    // An item and not a graph, so it can be moved without reallocating data
+    cursor_line = new QCPItemStraightLine(this);
+    this->addItem(cursor_line);
+    cursor_line->setPen(QPen(Qt::blue));
+    cursor_line->point1->setCoords(0,0);
+    cursor_line->point2->setCoords(0,1);
 
     return;
 }
 
+// Appends the tick the market has just simulated to the series. Drawing
+// is left to render(), which runs at the frame rate and not per tick.
+// Hidden plots skip the tick and are rebuilt from the market history once
+// they are shown again.
 void StockPriceHistoryPlot::setData(void)
 {
-    if (i > xmax)
-        i = 0;
+    TRACE_SPAN("StockPriceHistoryPlot::setData");
+    ALLOCATION_PHASE(phase_set_data);
 
-    update_limitx[0] = update_limitx[1] = (i+1)%1000;
-    double current_price = 0;
+    if ( ticker < 0 || ! market.isListed(ticker) )
+        return;
 
-    // Random number calculation
+    if ( ! isVisible() || window()->isMinimized() )
+    {
+        stale = true;
+        return;
+    }
 
-    y[i] = current_price = company.updatePrice();
+    if ( stale )
+    {
+        catchUp();
+        return;
+    }
 
-    i++;
+    int i = market.lastPosition();
+    double current_price = market.price(ticker);
 
-    avg.fill(company.avg_depot_price,2); // Set (0,avg_price) and (xmax,avg_price) for the green line.
+    y[i] = current_price;
+    this->graph(0)->setDataValue(i,current_price);
 
-    this->graph(0)->setData(x,y);
-    this->graph(1)->setData(avgx,avg);
-    this->graph(2)->setData(update_limitx,update_limit);
+    appendIndicators(i,market.getIndicators(),ticker);
 
-    //std::cout << "Average price in dep: " << company.avg_depot_price << "\n";
+    // Only mutates the candle of the current interval
+    candles->addTick((i / ticks_per_candle) * ticks_per_candle + 0.5 * ticks_per_candle, current_price);
 
-    this->replot();
+    dirty = true;
 
-    if ( current_price == 0 )
-        emit bankrupt();
-    if ( company.splitted )
+    return;
+}
+
+// Draws the ticks that arrived since the last frame, if any. The replot is
+// queued, so a frame together with a relisting or a toggled check box is
+// rendered only once.
+void StockPriceHistoryPlot::render(void)
+{
+    TRACE_SPAN("StockPriceHistoryPlot::render");
+    ALLOCATION_PHASE(phase_set_data);
+
+    if ( ! dirty || ticker < 0 )
+        return;
+
+    dirty = false;
+    frame_tick_time = market.getLastTickTime();
+
+    // Set (0,avg_price) and (xmax,avg_price) for the green line.
+    double avg_price = market.company(ticker)->avg_depot_price.toDouble();
+    this->graph(1)->setDataValue(0,avg_price);
+    this->graph(1)->setDataValue(xmax,avg_price);
+
+    cursor_line->point1->setCoords(market.cursor(),0);
+    cursor_line->point2->setCoords(market.cursor(),1);
+
+    if ( hover_index >= 0 )
+        updateCrosshair();
+
+    this->replot(QCustomPlot::rpQueuedReplot);
+
+    emit priceChanged(market.price(ticker));
+
+    return;
+}
+
+void StockPriceHistoryPlot::paintEvent(QPaintEvent *event)
+{
+    QCustomPlot::paintEvent(event);
+
+    // Only the first paint of a frame counts for the latency
+    if ( frame_tick_time > 0 )
     {
-        company.splitted = false;
-        emit splitted();
+        paint_latency->record(MetricsRegistry::now() - frame_tick_time);
+        frame_tick_time = 0;
     }
-    emit priceChanged(current_price);
 
     return;
-}
\ No newline at end of file
+}
+
+void StockPriceHistoryPlot::replotStarted(void)
+{
+    replot_begin = MetricsRegistry::now();
+
+    return;
+}
+
+void StockPriceHistoryPlot::replotFinished(void)
+{
+    replot_time->record(MetricsRegistry::now() - replot_begin);
+
+    return;
+}
+
+void StockPriceHistoryPlot::showEvent(QShowEvent *event)
+{
+    QCustomPlot::showEvent(event);
+
+    catchUp();
+
+    return;
+}
+
+void StockPriceHistoryPlot::catchUp(void)
+{
+    if ( ! stale || ticker < 0 )
+        return;
+
+    bindTicker(ticker);
+
+    return;
+}
+
+// Switches between the line chart and the candlestick chart
+void StockPriceHistoryPlot::setCandleChart(bool on)
+{
+    candle_chart = on;
+    candles->setVisible(on);
+    this->graph(0)->setVisible(!on);
+
+    this->replot(QCustomPlot::rpQueuedReplot);
+
+    return;
+}
+
+void StockPriceHistoryPlot::setIndicators(bool on)
+{
+    show_indicators = on;
+    for (int k = 2; k < 5; k++)
+        this->graph(k)->setVisible(on);
+
+    this->replot(QCustomPlot::rpQueuedReplot);
+
+    return;
+}
+
+// Sets the indicator values at the given position. Only that point is
+// replaced in place, the rest of the series stays untouched.
+void StockPriceHistoryPlot::appendIndicators(int position, const IndicatorBank &bank, int bank_ticker)
+{
+    const IndicatorBank::Indicator series[3] = { IndicatorBank::SMA, IndicatorBank::UpperBand, IndicatorBank::LowerBand };
+
+    for (int k = 0; k < 3; k++)
+    {
+        double value = bank.isReady(bank_ticker) ? bank.value(series[k],bank_ticker) : qQNaN();
+
+        this->graph(2+k)->setDataValue(position,value);
+    }
+
+    return;
+}
+
+void StockPriceHistoryPlot::initCrosshair(void)
+{
+    this->addLayer("overlay");
+    overlay = this->layer("overlay");
+    overlay->setMode(QCPLayer::lmBuffered);
+
+    cross_v = new QCPItemStraightLine(this);
+    cross_h = new QCPItemStraightLine(this);
+    readout = new QCPItemText(this);
+    this->addItem(cross_v);
+    this->addItem(cross_h);
+    this->addItem(readout);
+
+    cross_v->setPen(QPen(Qt::darkGray,1,Qt::DotLine));
+    cross_h->setPen(QPen(Qt::darkGray,1,Qt::DotLine));
+
+    readout->position->setType(QCPItemPosition::ptAxisRectRatio);
+    readout->position->setCoords(0.01,0.01);
+    readout->setPositionAlignment(Qt::AlignLeft|Qt::AlignTop);
+    readout->setBrush(QBrush(QColor(255,255,255,200)));
+
+    cross_v->setLayer(overlay);
+    cross_h->setLayer(overlay);
+    readout->setLayer(overlay);
+
+    cross_v->setVisible(false);
+    cross_h->setVisible(false);
+    readout->setVisible(false);
+
+    return;
+}
+
+// Moves the crosshair onto the sample under the mouse. The samples are
+// stored by tick index, so the nearest one is found in O(1).
+void StockPriceHistoryPlot::mouseMoveEvent(QMouseEvent *event)
+{
+    QCustomPlot::mouseMoveEvent(event);
+
+    int index = qRound(this->xAxis->pixelToCoord(event->pos().x()));
+
+    if ( y.isEmpty() || ! this->axisRect()->rect().contains(event->pos()) )
+        index = -1;
+    else
+        index = qBound(0,index,xmax);
+
+    if ( index != hover_index )
+    {
+        hover_index = index;
+        updateCrosshair();
+        overlay->replot();
+    }
+
+    return;
+}
+
+void StockPriceHistoryPlot::leaveEvent(QEvent *event)
+{
+    QCustomPlot::leaveEvent(event);
+
+    hover_index = -1;
+    updateCrosshair();
+    overlay->replot();
+
+    return;
+}
+
+// Only the overlay layer has to be redrawn after this, the rest of the plot
+// comes from the cached frame.
+void StockPriceHistoryPlot::updateCrosshair(void)
+{
+    bool on = hover_index >= 0;
+
+    cross_v->setVisible(on);
+    cross_h->setVisible(on);
+    readout->setVisible(on);
+
+    if ( on )
+    {
+        double price = y[hover_index];
+
+        cross_v->point1->setCoords(hover_index,0);
+        cross_v->point2->setCoords(hover_index,1);
+        cross_h->point1->setCoords(0,price);
+        cross_h->point2->setCoords(1,price);
+
+        readout->setText(QString("Tick %1: %2").arg(hover_index).arg(price,0,'f',2));
+    }
+
+    return;
+}
@@ -0,0 +1,149 @@
+#include <trace.h>
+
+#ifdef STOCKTRADER_TRACE
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 begin, end;
+};
+
+// Written by its own thread only. head counts all events ever written,
+// the event n lives in events[n % trace_buffer_size].
+struct TraceBuffer
+{
+    TraceEvent events[trace_buffer_size];
+    std::atomic<quint64> head;
+    int thread;
+};
+
+// Only locked when a thread records its first span, on intern() and on dump()
+static QMutex registry_mutex;
+static QList<TraceBuffer*> buffers;
+static QHash<QString,QByteArray> names;
+
+static qint64 now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static TraceBuffer *threadBuffer(void)
+{
+    static thread_local TraceBuffer *buffer = 0;
+
+    if ( ! buffer )
+    {
+        buffer = new TraceBuffer;
+        buffer->head.store(0);
+
+        QMutexLocker lock(&registry_mutex);
+        buffer->thread = buffers.size() + 1;
+        buffers.append(buffer);
+    }
+
+    return buffer;
+}
+
+TraceSpan::TraceSpan(const char *n) :
+    name(n), begin(now())
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+    TraceBuffer *buffer = threadBuffer();
+    quint64 head = buffer->head.load(std::memory_order_relaxed);
+
+    TraceEvent &event = buffer->events[head % trace_buffer_size];
+    event.name = name;
+    event.begin = begin;
+    event.end = now();
+
+    buffer->head.store(head + 1,std::memory_order_release);
+}
+
+// Returns a pointer that stays valid for the rest of the program
+const char *Trace::intern(const QString &name)
+{
+    QMutexLocker lock(&registry_mutex);
+
+    QHash<QString,QByteArray>::iterator it = names.find(name);
+    if ( it == names.end() )
+        it = names.insert(name,name.toUtf8());
+
+    return it.value().constData();
+}
+
+static QString jsonString(const char *s)
+{
+    QString escaped = QString::fromUtf8(s);
+    escaped.replace("\\","\\\\").replace("\"","\\\"");
+
+    return "\"" + escaped + "\"";
+}
+
+// The threads keep recording while their buffers are copied. Events the
+// writer may have overwritten during the copy are dropped afterwards,
+// including the one in the slot it may still be writing.
+bool Trace::dump(const QString &file_name)
+{
+    QFile file(file_name);
+    if ( ! file.open(QIODevice::WriteOnly | QIODevice::Text) )
+        return false;
+
+    QTextStream out(&file);
+    out << "{\"traceEvents\":[\n";
+
+    QMutexLocker lock(&registry_mutex);
+    bool first = true;
+
+    foreach (TraceBuffer *buffer, buffers)
+    {
+        quint64 head = buffer->head.load(std::memory_order_acquire);
+        quint64 count = qMin<quint64>(head,trace_buffer_size);
+
+        QVector<TraceEvent> events(int(count));
+        for (quint64 k = 0; k < count; k++)
+            events[int(k)] = buffer->events[(head - count + k) % trace_buffer_size];
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // The event 'written' and the ones after it reuse the slots of the events before 'reused'
+        quint64 written = buffer->head.load(std::memory_order_relaxed);
+        quint64 reused = written + 1 > quint64(trace_buffer_size) ? written + 1 - trace_buffer_size : 0;
+        quint64 oldest = head - count;
+        quint64 torn = reused > oldest ? reused - oldest : 0;
+
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+            << ",\"args\":{\"name\":\"" << (buffer->thread == 1 ? "GUI" : "thread") << " " << buffer->thread << "\"}}";
+        first = false;
+
+        for (quint64 k = qMin(torn,count); k < count; k++)
+        {
+            const TraceEvent &event = events[int(k)];
+
+            out << ",\n{\"name\":" << jsonString(event.name)
+                << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+                << ",\"ts\":" << QString::number(event.begin / 1000.0,'f',3)
+                << ",\"dur\":" << QString::number((event.end - event.begin) / 1000.0,'f',3) << "}";
+        }
+    }
+
+    out << "\n]}\n";
+
+    return true;
+}
+
+#endif // STOCKTRADER_TRACE
@@ -0,0 +1,590 @@
+#include <triggerbook.h>
+#include <orderbook.h>
+#include <trace.h>
+
+PairingHeaps::PairingHeaps(int size) :
+    nodes(size)
+{
+}
+
+qint64 PairingHeaps::key(int node) const
+{
+    return nodes[node].key;
+}
+
+void PairingHeaps::setKey(int node, qint64 key)
+{
+    nodes[node].key = key;
+
+    return;
+}
+
+int PairingHeaps::push(int root, int node, qint64 key)
+{
+    Node &n = nodes[node];
+
+    n.key = key;
+    n.child = n.sibling = n.prev = -1;
+
+    return meld(root,node);
+}
+
+int PairingHeaps::meld(int a, int b)
+{
+    if ( a < 0 )
+        return b;
+    if ( b < 0 )
+        return a;
+
+    int root = link(a,b);
+    nodes[root].sibling = nodes[root].prev = -1;
+
+    return root;
+}
+
+int PairingHeaps::remove(int root, int node)
+{
+    if ( node == root )
+        return mergePairs(nodes[root].child);
+
+    // Cut the subtree of the node and meld its children back in
+    Node &n = nodes[node];
+
+    if ( nodes[n.prev].child == node )
+        nodes[n.prev].child = n.sibling;
+    else
+        nodes[n.prev].sibling = n.sibling;
+    if ( n.sibling >= 0 )
+        nodes[n.sibling].prev = n.prev;
+
+    return meld(root,mergePairs(n.child));
+}
+
+// Makes the root with the smaller key the first child of the other one.
+// The sibling and prev of the returned root are left to the caller.
+int PairingHeaps::link(int a, int b)
+{
+    if ( nodes[b].key > nodes[a].key )
+        qSwap(a,b);
+
+    Node &parent = nodes[a];
+    Node &child = nodes[b];
+
+    child.sibling = parent.child;
+    child.prev = a;
+    if ( parent.child >= 0 )
+        nodes[parent.child].prev = b;
+    parent.child = b;
+
+    return a;
+}
+
+// Two-pass pairing of a list of siblings: link them in pairs from the
+// left, then meld the pairs from the right. The pairs are chained through
+// their sibling links, so it needs no stack.
+int PairingHeaps::mergePairs(int first)
+{
+    int pairs = -1;
+
+    while ( first >= 0 )
+    {
+        int a = first;
+        int b = nodes[a].sibling;
+        int pair = a;
+
+        if ( b >= 0 )
+        {
+            first = nodes[b].sibling;
+            pair = link(a,b);
+        }
+        else
+            first = -1;
+
+        nodes[pair].sibling = pairs;
+        pairs = pair;
+    }
+
+    int root = -1;
+
+    while ( pairs >= 0 )
+    {
+        int next = nodes[pairs].sibling;
+        nodes[pairs].sibling = nodes[pairs].prev = -1;
+        root = meld(root,pairs);
+        pairs = next;
+    }
+
+    return root;
+}
+
+// Stop-losses fire at a price at or below theirs, take-profits at or
+// above, trailing stops of a group from the smallest distance on.
+static qint64 heapKey(const Trigger &trigger)
+{
+    return trigger.kind == Trigger::StopLoss ? trigger.price : -qint64(trigger.price);
+}
+
+TriggerBook::TriggerBook(int n) :
+    tickers(0), sequence(0),
+    triggers(trigger_pool_size), free_triggers(-1), trigger_heaps(trigger_pool_size),
+    groups(trigger_pool_size), free_groups(-1), group_heaps(trigger_pool_size),
+    events(trigger_pool_size), event_count(0)
+{
+    resize(n);
+}
+
+void TriggerBook::resize(int n)
+{
+    tickers = n;
+    stop_losses.fill(-1,n);
+    take_profits.fill(-1,n);
+    trailing.fill(-1,n);
+    group_tops.fill(-1,n);
+    ticker_triggers.fill(-1,n);
+
+    free_triggers = free_groups = -1;
+    for (int k = trigger_pool_size - 1; k >= 0; k--)
+    {
+        triggers[k].id = 0;
+        triggers[k].next = free_triggers;
+        free_triggers = k;
+
+        groups[k].higher = free_groups;
+        free_groups = k;
+    }
+
+    event_count = 0;
+
+    return;
+}
+
+qint64 TriggerBook::place(int account, int t, Trigger::Kind kind, int quantity, int price, int current_price)
+{
+    if ( t < 0 || t >= tickers || quantity <= 0 || price <= 0 || free_triggers < 0 )
+        return 0;
+    if ( kind == Trigger::TrailingStop && current_price <= 0 )
+        return 0;
+
+    int k = free_triggers;
+    Trigger &trigger = triggers[k];
+    free_triggers = trigger.next;
+
+    trigger.id = (++sequence << trigger_index_bits) | k;
+    trigger.account = account;
+    trigger.ticker = t;
+    trigger.kind = kind;
+    trigger.quantity = quantity;
+    trigger.price = price;
+    trigger.group = trigger.prev = trigger.next = -1;
+
+    int &first = ticker_triggers[t];
+
+    if ( first < 0 )
+    {
+        trigger.ticker_prev = trigger.ticker_next = k;
+        first = k;
+    }
+    else
+    {
+        trigger.ticker_next = first;
+        trigger.ticker_prev = triggers[first].ticker_prev;
+        triggers[trigger.ticker_prev].ticker_next = k;
+        triggers[trigger.ticker_next].ticker_prev = k;
+    }
+
+    if ( kind == Trigger::StopLoss )
+    {
+        stop_losses[t] = trigger_heaps.push(stop_losses[t],k,heapKey(trigger));
+        return trigger.id;
+    }
+    if ( kind == Trigger::TakeProfit )
+    {
+        take_profits[t] = trigger_heaps.push(take_profits[t],k,heapKey(trigger));
+        return trigger.id;
+    }
+
+    // Join the group of the current price, which can only be the top one
+    raisePeaks(t,current_price);
+
+    int g = group_tops[t];
+
+    if ( g >= 0 && groups[g].peak == current_price )
+        detachGroup(g);
+    else
+    {
+        g = free_groups;
+        free_groups = groups[g].higher;
+
+        groups[g].ticker = t;
+        groups[g].peak = current_price;
+        groups[g].size = 0;
+        groups[g].members = groups[g].distances = -1;
+        pushGroup(t,g);
+    }
+
+    TrailingGroup &group = groups[g];
+
+    trigger.group = g;
+    if ( group.members < 0 )
+    {
+        trigger.prev = trigger.next = k;
+        group.members = k;
+    }
+    else
+    {
+        trigger.next = group.members;
+        trigger.prev = triggers[group.members].prev;
+        triggers[trigger.prev].next = k;
+        triggers[trigger.next].prev = k;
+    }
+    group.size++;
+    group.distances = trigger_heaps.push(group.distances,k,heapKey(trigger));
+
+    attachGroup(g);
+
+    return trigger.id;
+}
+
+bool TriggerBook::cancel(qint64 id)
+{
+    int k = find(id);
+
+    if ( k < 0 )
+        return false;
+
+    remove(k);
+
+    return true;
+}
+
+void TriggerBook::cancelAll(int t, int account)
+{
+    if ( t < 0 || t >= tickers || ticker_triggers[t] < 0 )
+        return;
+
+    // Removing a trigger keeps the ring of the others, the last one is
+    // taken before it may go
+    int k = ticker_triggers[t];
+    int last = triggers[k].ticker_prev;
+
+    for (;;)
+    {
+        int next = triggers[k].ticker_next;
+        bool done = k == last;
+
+        if ( account < 0 || triggers[k].account == account )
+            remove(k);
+        if ( done )
+            break;
+        k = next;
+    }
+
+    return;
+}
+
+void TriggerBook::split(int t, int ratio)
+{
+    rescale(t,1,ratio);
+
+    return;
+}
+
+void TriggerBook::consolidate(int t, int ratio)
+{
+    if ( ticker_triggers[t] >= 0 )
+    {
+        int k = ticker_triggers[t];
+        int last = triggers[k].ticker_prev;
+
+        for (;;)
+        {
+            int next = triggers[k].ticker_next;
+            bool done = k == last;
+
+            if ( triggers[k].quantity < ratio )
+                remove(k);
+            if ( done )
+                break;
+            k = next;
+        }
+    }
+
+    rescale(t,ratio,1);
+
+    return;
+}
+
+// Multiplies the prices by num / den and the quantities by den / num.
+// That keeps the order of the trigger heaps, so only the group heap of
+// the ticker is rebuilt, since the rounding of the firing prices may not.
+void TriggerBook::rescale(int t, int num, int den)
+{
+    int first = ticker_triggers[t];
+
+    if ( first >= 0 )
+    {
+        int k = first;
+        do
+        {
+            Trigger &trigger = triggers[k];
+
+            trigger.price = qMax(1,trigger.price * num / den);
+            trigger.quantity = trigger.quantity * den / num;
+            trigger_heaps.setKey(k,heapKey(trigger));
+            k = trigger.ticker_next;
+        }
+        while ( k != first );
+    }
+
+    trailing[t] = -1;
+    for (int g = group_tops[t]; g >= 0; g = groups[g].higher)
+    {
+        groups[g].peak = groups[g].peak * num / den;
+        attachGroup(g);
+    }
+
+    return;
+}
+
+void TriggerBook::evaluate(const double *prices)
+{
+    TRACE_SPAN("TriggerBook::evaluate");
+
+    for (int t = 0; t < tickers; t++)
+    {
+        if ( prices[t] <= 0 )
+            continue;
+
+        int price = MatchingEngine::toTicks(prices[t]);
+
+        raisePeaks(t,price);
+
+        while ( stop_losses[t] >= 0 && trigger_heaps.key(stop_losses[t]) >= price )
+            fire(stop_losses[t],price);
+
+        while ( take_profits[t] >= 0 && trigger_heaps.key(take_profits[t]) >= -price )
+            fire(take_profits[t],price);
+
+        while ( trailing[t] >= 0 && group_heaps.key(trailing[t]) >= price )
+            fire(groups[trailing[t]].distances,price);
+    }
+
+    return;
+}
+
+int TriggerBook::eventCount(void) const
+{
+    return event_count;
+}
+
+const TriggerEvent &TriggerBook::event(int k) const
+{
+    return events[k];
+}
+
+void TriggerBook::clearEvents(void)
+{
+    event_count = 0;
+
+    return;
+}
+
+int TriggerBook::find(qint64 id) const
+{
+    int index = int(id & ((Q_INT64_C(1) << trigger_index_bits) - 1));
+
+    if ( id <= 0 || index >= trigger_pool_size || triggers[index].id != id )
+        return -1;
+
+    return index;
+}
+
+// Melds the groups whose peak the price has risen past into one with the
+// price as its peak. They are the top of the stack.
+void TriggerBook::raisePeaks(int t, int price)
+{
+    int g = group_tops[t];
+
+    if ( g < 0 || groups[g].peak >= price )
+        return;
+
+    detachGroup(g);
+
+    int h;
+    while ( ( h = groups[g].higher ) >= 0 && groups[h].peak < price )
+    {
+        detachGroup(h);
+        g = absorb(g,h);
+    }
+
+    groups[g].peak = price;
+    attachGroup(g);
+
+    return;
+}
+
+void TriggerBook::fire(int k, int price)
+{
+    Q_ASSERT(event_count < events.size());
+
+    const Trigger &trigger = triggers[k];
+    TriggerEvent &e = events[event_count++];
+
+    e.trigger = trigger.id;
+    e.account = trigger.account;
+    e.ticker = trigger.ticker;
+    e.kind = trigger.kind;
+    e.quantity = trigger.quantity;
+    e.price = price;
+
+    remove(k);
+
+    return;
+}
+
+// Takes the trigger out of its heap and returns it to the pool, an emptied
+// group is dropped
+void TriggerBook::remove(int k)
+{
+    Trigger &trigger = triggers[k];
+    int t = trigger.ticker;
+
+    if ( trigger.kind == Trigger::StopLoss )
+        stop_losses[t] = trigger_heaps.remove(stop_losses[t],k);
+    else if ( trigger.kind == Trigger::TakeProfit )
+        take_profits[t] = trigger_heaps.remove(take_profits[t],k);
+    else
+    {
+        TrailingGroup &group = groups[trigger.group];
+
+        detachGroup(trigger.group);
+        group.distances = trigger_heaps.remove(group.distances,k);
+
+        if ( --group.size == 0 )
+            unlinkGroup(trigger.group);
+        else
+        {
+            triggers[trigger.prev].next = trigger.next;
+            triggers[trigger.next].prev = trigger.prev;
+            if ( group.members == k )
+                group.members = trigger.next;
+
+            attachGroup(trigger.group);
+        }
+    }
+
+    unlinkTrigger(k);
+
+    trigger.id = 0;
+    trigger.next = free_triggers;
+    free_triggers = k;
+
+    return;
+}
+
+// Takes the trigger out of the ring of its ticker
+void TriggerBook::unlinkTrigger(int k)
+{
+    Trigger &trigger = triggers[k];
+    int &first = ticker_triggers[trigger.ticker];
+
+    if ( trigger.ticker_next == k )
+        first = -1;
+    else
+    {
+        triggers[trigger.ticker_prev].ticker_next = trigger.ticker_next;
+        triggers[trigger.ticker_next].ticker_prev = trigger.ticker_prev;
+        if ( first == k )
+            first = trigger.ticker_next;
+    }
+
+    return;
+}
+
+// Merges two neighbouring groups of the stack, which are both out of the
+// group heap. The members of the smaller one move to the larger one, which
+// is returned, so every trigger moves O(log n) times at most.
+int TriggerBook::absorb(int a, int b)
+{
+    if ( groups[a].size < groups[b].size )
+        qSwap(a,b);
+
+    TrailingGroup &large = groups[a];
+    TrailingGroup &small = groups[b];
+
+    int k = small.members;
+    do
+    {
+        triggers[k].group = a;
+        k = triggers[k].next;
+    }
+    while ( k != small.members );
+
+    // Splice the rings
+    int large_last = triggers[large.members].prev;
+    int small_last = triggers[small.members].prev;
+
+    triggers[large_last].next = small.members;
+    triggers[small.members].prev = large_last;
+    triggers[small_last].next = large.members;
+    triggers[large.members].prev = small_last;
+
+    large.size += small.size;
+    large.distances = trigger_heaps.meld(large.distances,small.distances);
+
+    unlinkGroup(b);
+
+    return a;
+}
+
+void TriggerBook::pushGroup(int t, int g)
+{
+    TrailingGroup &group = groups[g];
+
+    group.lower = -1;
+    group.higher = group_tops[t];
+    if ( group.higher >= 0 )
+        groups[group.higher].lower = g;
+    group_tops[t] = g;
+
+    return;
+}
+
+// Takes the group off the stack and returns it to the pool
+void TriggerBook::unlinkGroup(int g)
+{
+    TrailingGroup &group = groups[g];
+
+    if ( group.lower >= 0 )
+        groups[group.lower].higher = group.higher;
+    else
+        group_tops[group.ticker] = group.higher;
+    if ( group.higher >= 0 )
+        groups[group.higher].lower = group.lower;
+
+    group.higher = free_groups;
+    free_groups = g;
+
+    return;
+}
+
+// Puts the group into the heap of its ticker, keyed by the price at which
+// its smallest distance fires
+void TriggerBook::attachGroup(int g)
+{
+    const TrailingGroup &group = groups[g];
+    qint64 firing_price = group.peak + trigger_heaps.key(group.distances);
+
+    trailing[group.ticker] = group_heaps.push(trailing[group.ticker],g,firing_price);
+
+    return;
+}
+
+void TriggerBook::detachGroup(int g)
+{
+    int t = groups[g].ticker;
+
+    trailing[t] = group_heaps.remove(trailing[t],g);
+
+    return;
+}
@@ -7,8 +7,12 @@
 
 QT       += core gui
 
+QT       += network
+
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
 
+CONFIG   += c++11
+
 TARGET = stocktrader
 TEMPLATE = app
 
@@ -17,20 +21,57 @@ SOURCES += src/main.cpp\
     lib/qcustomplot.cpp \
     src/stockpricehistoryplot.cpp \
     src/singlestock.cpp \
-    src/moneyavailable.cpp \
+    src/ledger.cpp \
     src/localpricegen.cpp \
     src/genericpricegenerator.cpp \
-    src/company.cpp
+    src/company.cpp \
+    src/lotqueue.cpp \
+    src/corporateactions.cpp \
+    src/basketbook.cpp \
+    src/indicatorbank.cpp \
+    src/riskbank.cpp \
+    src/chartexporter.cpp \
+    src/market.cpp \
+    src/stockgrid.cpp \
+    src/marketmodel.cpp \
+    src/sparklinedelegate.cpp \
+    src/trace.cpp \
+    src/metrics.cpp \
+    src/metricsserver.cpp \
+    src/allocationcounter.cpp \
+    src/orderbook.cpp \
+    src/triggerbook.cpp \
+    src/marginbook.cpp \
+    src/portfolio.cpp
 
 HEADERS  +=\
     header/mainwindow.h \
     lib/qcustomplot.h \
     header/stockpricehistoryplot.h \
     header/singlestock.h \
-    header/moneyavailable.h \
+    header/ledger.h \
+    header/money.h \
     header/localpricegen.h \
     header/genericpricegenerator.h \
-    header/company.h
+    header/company.h \
+    header/lotqueue.h \
+    header/corporateactions.h \
+    header/basketbook.h \
+    header/indicatorbank.h \
+    header/riskbank.h \
+    header/chartexporter.h \
+    header/market.h \
+    header/stockgrid.h \
+    header/marketmodel.h \
+    header/sparklinedelegate.h \
+    header/trace.h \
+    header/metrics.h \
+    header/metricsserver.h \
+    header/allocationcounter.h \
+    header/orderbook.h \
+    header/triggerbook.h \
+    header/marginbook.h \
+    header/portfolio.h
 
 FORMS    += mainwindow.ui \
     singlestock.ui
@@ -38,4 +79,15 @@ FORMS    += mainwindow.ui \
 OTHER_FILES += \
     LICENSE.txt
 
+# "qmake CONFIG+=trace" compiles in the trace spans of header/trace.h
+CONFIG(trace): DEFINES += STOCKTRADER_TRACE
+
+# "qmake CONFIG+=alloccount" counts heap allocations per tick phase, see header/allocationcounter.h
+CONFIG(alloccount): DEFINES += STOCKTRADER_ALLOC_COUNT
+
+# "make bench" builds the benchmark suite in bench/ (see README.md)
+bench.commands = mkdir -p bench && cd bench && $(QMAKE) $$PWD/bench/bench.pro && $(MAKE)
+bench.CONFIG += phony # there is a bench/ directory in the source root
+QMAKE_EXTRA_TARGETS += bench
+
 INCLUDEPATH += header/ lib/
\ No newline at end of file